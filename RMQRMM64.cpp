@@ -6,6 +6,11 @@
  */
 
 #include "includes/RMQRMM64.h"
+#include <omp.h>
+#include <vector>
+#ifdef RMM_WORD_OPS
+#include <immintrin.h>
+#endif
 
 bool RMQRMM64::TRACE = false;
 bool RMQRMM64::RUNTEST = false;
@@ -60,58 +65,7 @@ void RMQRMM64::init(ulong len) {
 // if deleteA=true then the array A will the delete after to create the BP sequence P
 RMQRMM64::RMQRMM64(ulong *A, uint bitsPC, ulong len, bool deleteA){
 	init(len);
-	ulong i, n_i, n_top, pos;
-	StackBP *Q = new StackBP();
-	StackBP *R;
-	long long int top = -1;
-
-	// [1] insert root in Q and put an opening parenthesis
-	i = pos = 0;
-	setBit64(P, pos);
-	pos++;
-	Q->val = top;
-	Q->next = NULL;
-
-	// insert A[0]
-	R = new StackBP();
-	R->val = 0;
-	R->next = Q;
-	Q = R;
-	setBit64(P, pos);
-	pos++;
-	top = 0;
-
-	for(i=1; i<len; i++){
-		// [2] append a closing parenthesis for each value j > 0 stored in Q, such that A[j] ≥ A[i], deleting these values from Q.
-		n_top = getNum64(A, top*bitsPC, bitsPC);
-		n_i = getNum64(A, i*bitsPC, bitsPC);
-		while(top>-1 && n_top >= n_i){
-			cleanBit64(P, pos);
-			pos++;
-			R = Q;
-			Q = Q->next;
-			delete R;
-			top = Q->val;
-			if(top>-1)
-				n_top = getNum64(A, top*bitsPC, bitsPC);
-		}
-		// [3] insert A[i] into Q and add an opening parenthesis
-		R = new StackBP();
-		R->val = i;
-		R->next = Q;
-		Q = R;
-		setBit64(P, pos);
-		pos++;
-		top = i;
-	}
-	// [4] add an opening parenthesis for each value stored in Q
-	while(Q){
-		cleanBit64(P, pos);
-		pos++;
-		R = Q;
-		Q = Q->next;
-		delete R;
-	}
+	ulong pos = createBPSequence([A, bitsPC](ulong i) { return getNum64(A, i*bitsPC, bitsPC); }, len);
 
 	if(deleteA){
 		cout << " Deleting array A[] ... " << endl;
@@ -136,47 +90,92 @@ RMQRMM64::RMQRMM64(ulong *A, uint bitsPC, ulong len, bool deleteA){
 	createMinMaxTree();
 }
 
-RMQRMM64::RMQRMM64(short int *A, ulong len) {
-	init(len);
+// Creates the BP sequence in parallel. A[0..len-1] is split into chunks, one per thread, and each chunk runs
+// its own stack Q. A chunk knows all its parentheses except the closing ones that its prefix minima append for
+// values of previous chunks, so the stacks left by the chunks are merged sequentially to count these and to
+// compute the starting position of each chunk in P. Then the chunks write their open parentheses in parallel.
+// valueAt(i) returns A[i].
+template<typename ValueAt> ulong RMQRMM64::createBPSequence(ValueAt valueAt, ulong len){
+	const ulong lenP = (nP >> BW64) + (nP % W64 ? 1 : 0);
+	ulong chunksCount = len >> 16;
+	if (chunksCount > (ulong) omp_get_max_threads())
+		chunksCount = omp_get_max_threads();
+	if (chunksCount == 0)
+		chunksCount = 1;
+	const ulong chunkLen = (len + chunksCount - 1) / chunksCount;
+	vector<vector<ulong>> restQ(chunksCount), prefixMins(chunksCount), extraClosings(chunksCount);
+	vector<ulong> chunkPos(chunksCount + 1);
+
+	// [1] for each chunk, store its prefix minima (the local stack is empty after [2]) and the remaining local stack
+	#pragma omp parallel for schedule(static, 1)
+	for (ulong c = 0; c < chunksCount; c++){
+		vector<ulong> &Q = restQ[c];
+		const ulong end = min(len, (c + 1) * chunkLen);
+		for (ulong i = c * chunkLen; i < end; i++){
+			while(!Q.empty() && valueAt(Q.back()) >= valueAt(i))
+				Q.pop_back();
+			if (Q.empty())
+				prefixMins[c].push_back(i);
+			Q.push_back(i);
+		}
+	}
 
-	ulong i, pos=0;
-	StackBP *Q = new StackBP();
-	StackBP *R;
-	long long int top = -1;
-
-	// [1] insert root in Q and put an opening parenthesis
-	setBit64(P, pos);
-	pos++;
-	Q->val = top;
-	Q->next = NULL;
-	for(i=0; i<len; i++){
-		// [2] append a closing parenthesis for each value j > 0 stored in Q, such that A[j] ≥ A[i], deleting these values from Q.
-		while(top>-1 && A[top] >= A[i]){
-			cleanBit64(P, pos);
+	// [2] merge the remaining stacks, counting the closing parentheses of prefix minima for values of previous chunks
+	vector<ulong> Q;
+	chunkPos[0] = 1;
+	for (ulong c = 0; c < chunksCount; c++){
+		const ulong beg = min(len, c * chunkLen), end = min(len, (c + 1) * chunkLen);
+		ulong closings = (end - beg) - restQ[c].size();
+		for (ulong i : prefixMins[c]){
+			ulong extra = 0;
+			while(!Q.empty() && valueAt(Q.back()) >= valueAt(i)){
+				Q.pop_back();
+				extra++;
+			}
+			extraClosings[c].push_back(extra);
+			closings += extra;
+		}
+		Q.insert(Q.end(), restQ[c].begin(), restQ[c].end());
+		vector<ulong>().swap(restQ[c]);
+		chunkPos[c + 1] = chunkPos[c] + (end - beg) + closings;
+	}
+
+	// [3] put the open parentheses, the closing ones are the cleared bits (the ones of the boundary words are shared by chunks)
+	#pragma omp parallel for
+	for (ulong w = 0; w < lenP; w++)
+		P[w] = 0;
+	setBit64(P, 0);
+	#pragma omp parallel for schedule(static, 1)
+	for (ulong c = 0; c < chunksCount; c++){
+		vector<ulong> Q;
+		const ulong firstW = chunkPos[c] >> BW64, lastW = (chunkPos[c + 1] - 1) >> BW64;
+		const ulong end = min(len, (c + 1) * chunkLen);
+		ulong pos = chunkPos[c], j = 0;
+		for (ulong i = c * chunkLen; i < end; i++){
+			while(!Q.empty() && valueAt(Q.back()) >= valueAt(i)){
+				Q.pop_back();
+				pos++;
+			}
+			if (Q.empty())
+				pos += extraClosings[c][j++];
+			const ulong w = pos >> BW64;
+			if (w == firstW || w == lastW)
+				__sync_fetch_and_or(&P[w], maskW63 >> (pos % W64));
+			else
+				P[w] |= maskW63 >> (pos % W64);
 			pos++;
-			R = Q;
-			Q = Q->next;
-			delete R;
-			top = Q->val;
+			Q.push_back(i);
 		}
-		// [3] insert A[i] into Q and add an opening parenthesis
-		R = new StackBP();
-		R->val = i;
-		R->next = Q;
-		Q = R;
-		setBit64(P, pos);
-		pos++;
-		top = i;
-	}
-	// [4] add an opening parenthesis for each value stored in Q
-	while(Q){
-		cleanBit64(P, pos);
-		pos++;
-		R = Q;
-		Q = Q->next;
-		delete R;
 	}
 
+	// [4] add a closing parenthesis for each value stored in Q (and for the root)
+	return chunkPos[chunksCount] + Q.size() + 1;
+}
+
+RMQRMM64::RMQRMM64(short int *A, ulong len) {
+	init(len);
+	ulong pos = createBPSequence([A](ulong i) { return A[i]; }, len);
+
 	if(pos != 2*(len+1)){
 		cout << " ERROR. parentheses created = " << pos << " != " << 2*(len+1) << endl;
 		exit(0);
@@ -195,44 +194,7 @@ RMQRMM64::RMQRMM64(short int *A, ulong len) {
 
 RMQRMM64::RMQRMM64(int *A, ulong len) {
 	init(len);
-
-	ulong i, pos=0;
-	StackBP *Q = new StackBP();
-	StackBP *R;
-	long long int top = -1;
-
-	// [1] insert root in Q and put an opening parenthesis
-	setBit64(P, pos);
-	pos++;
-	Q->val = top;
-	Q->next = NULL;
-	for(i=0; i<len; i++){
-		// [2] append a closing parenthesis for each value j > 0 stored in Q, such that A[j] ≥ A[i], deleting these values from Q.
-		while(top>-1 && A[top] >= A[i]){
-			cleanBit64(P, pos);
-			pos++;
-			R = Q;
-			Q = Q->next;
-			delete R;
-			top = Q->val;
-		}
-		// [3] insert A[i] into Q and add an opening parenthesis
-		R = new StackBP();
-		R->val = i;
-		R->next = Q;
-		Q = R;
-		setBit64(P, pos);
-		pos++;
-		top = i;
-	}
-	// [4] add an opening parenthesis for each value stored in Q
-	while(Q){
-		cleanBit64(P, pos);
-		pos++;
-		R = Q;
-		Q = Q->next;
-		delete R;
-	}
+	ulong pos = createBPSequence([A](ulong i) { return A[i]; }, len);
 
 	if(pos != 2*(len+1)){
 		cout << " ERROR. parentheses created = " << pos << " != " << 2*(len+1) << endl;
@@ -250,46 +212,75 @@ RMQRMM64::RMQRMM64(int *A, ulong len) {
 	createMinMaxTree();
 }
 
-RMQRMM64::RMQRMM64(long long int *A, ulong len) {
+RMQRMM64::RMQRMM64(ulong len) {
 	init(len);
+	const ulong lenP = (nP >> BW64) + (nP % W64 ? 1 : 0);
+	#pragma omp parallel for
+	for (ulong w = 0; w < lenP; w++)
+		P[w] = 0;
+	setBit64(P, 0);
+	streamPos = 1;
+}
 
-	ulong i, pos=0;
-	StackBP *Q = new StackBP();
-	StackBP *R;
-	long long int top = -1;
-
-	// [1] insert root in Q and put an opening parenthesis
-	setBit64(P, pos);
-	pos++;
-	Q->val = top;
-	Q->next = NULL;
-	for(i=0; i<len; i++){
-		// [2] append a closing parenthesis for each value j > 0 stored in Q, such that A[j] ≥ A[i], deleting these values from Q.
-		while(top>-1 && A[top] >= A[i]){
-			cleanBit64(P, pos);
+void RMQRMM64::spillStreamQ() {
+	if (!streamQFile)
+		streamQFile = tmpfile();
+	if (!streamQFile || fseek(streamQFile, streamQChunks*QCHUNK*sizeof(int), SEEK_SET)
+			|| fwrite(&streamQ[0], sizeof(int), QCHUNK, streamQFile) != QCHUNK){
+		cout << " ERROR. cannot spill the stack Q to a temporary file" << endl;
+		exit(0);
+	}
+	streamQChunks++;
+	streamQ.erase(streamQ.begin(), streamQ.begin() + QCHUNK);
+}
+
+void RMQRMM64::reloadStreamQ() {
+	streamQChunks--;
+	streamQ.resize(QCHUNK);
+	if (fseek(streamQFile, streamQChunks*QCHUNK*sizeof(int), SEEK_SET)
+			|| fread(&streamQ[0], sizeof(int), QCHUNK, streamQFile) != QCHUNK){
+		cout << " ERROR. cannot reload the stack Q from a temporary file" << endl;
+		exit(0);
+	}
+}
+
+// the closing parentheses are the cleared bits of P
+void RMQRMM64::appendValues(const int *A, ulong count) {
+	ulong pos = streamPos;
+	for (ulong i = 0; i < count; i++){
+		while(!streamQ.empty() && streamQ.back() >= A[i]){
+			streamQ.pop_back();
 			pos++;
-			R = Q;
-			Q = Q->next;
-			delete R;
-			top = Q->val;
+			if (streamQ.empty() && streamQChunks)
+				reloadStreamQ();
 		}
-		// [3] insert A[i] into Q and add an opening parenthesis
-		R = new StackBP();
-		R->val = i;
-		R->next = Q;
-		Q = R;
-		setBit64(P, pos);
+		P[pos >> BW64] |= maskW63 >> (pos % W64);
 		pos++;
-		top = i;
+		if (streamQ.size() == 2*QCHUNK)
+			spillStreamQ();
+		streamQ.push_back(A[i]);
 	}
-	// [4] add an opening parenthesis for each value stored in Q
-	while(Q){
-		cleanBit64(P, pos);
-		pos++;
-		R = Q;
-		Q = Q->next;
-		delete R;
+	streamPos = pos;
+}
+
+void RMQRMM64::finishBuild() {
+	// a closing parenthesis for each value stored in Q and for the root
+	const ulong pos = streamPos + streamQChunks*QCHUNK + streamQ.size() + 1;
+	vector<int>().swap(streamQ);
+	if (streamQFile)
+		fclose(streamQFile);
+	streamQFile = 0;
+	streamQChunks = 0;
+	if(pos != nP){
+		cout << " ERROR. parentheses created = " << pos << " != " << nP << endl;
+		exit(0);
 	}
+	createMinMaxTree();
+}
+
+RMQRMM64::RMQRMM64(long long int *A, ulong len) {
+	init(len);
+	ulong pos = createBPSequence([A](ulong i) { return A[i]; }, len);
 
 	if(pos != 2*(len+1)){
 		cout << " ERROR. parentheses created = " << pos << " != " << 2*(len+1) << endl;
@@ -309,7 +300,7 @@ RMQRMM64::RMQRMM64(long long int *A, ulong len) {
 
 void RMQRMM64::createMinMaxTree(){
 	ulong groups, leavesUp, sizeDS;
-	ulong i, j, position, father, node, cont, child, rb;
+	ulong i, node, child;
 	int miniBck;
 	ulong *auxL, *auxR;
 	int *Aux_BkM;
@@ -393,106 +384,68 @@ void RMQRMM64::createMinMaxTree(){
 		auxL = new ulong[cantN];	// these are auxiliary vectors to facility the compute of intervals in each internal nodes. These will be delete later.
 		auxR = new ulong[cantN];
 
-		// Step 1: process the n bits in groups of size S, and create the leaves in each array:	intervals of relatives excess per block, in MinLeaf and MaxLeaf,
-		//         and the relative sum of excess per block, in ELeaf
-		// 'i' is for bits in P, 'cont' is for count the size of each block, and 'node' is the current leaf position to set min-max values...
-		//cout << "Step 1: process the n bits in groups of size s, and create the leaves in each array..." << endl;
-		j = firstLeaf; // this is for auxiliary vectors
-		ulong bitBottom = leavesBottom*BLK;
-		for (i=node=cont=0; i<nBin; i++){
-			if (i == bitBottom){
-				node = leavesBottom;	// we move up one level
-				j = cantIN;
-			}
-			if(cont==0){
-				auxL[j] = i;
-				position = j;
-				// set left boundaries, when the index j is the first child.
-				while(position && (position+1)%2==0){
-					father = (position+1)>>1;
-					if ((position+1)%2 > 1)
-						father++;
-					father--;
-					auxL[father] = i;
-					position = father;
-				}
-				cont=1;
-			}else{
-				cont++;
-				if(cont == BLK){
-					auxR[j] = i;
-					position = j;
-					// set right boundaries, when the index j is the last child. The last child always has rest == 1.
-					while(position && (position+1)%2==1){
-						father = (position+1)>>1;
-						if ((position+1)%2 > 1)
-							father++;
-						father--;
-						auxR[father] = i;
-						position = father;
-					}
-					node++;
-					j++;
-					cont = 0;
-				}
-			}
+		// Step 1: the leaves are the blocks of size S, the first leavesBottom ones are in the last level of the tree (from firstLeaf)
+		// and the rest are in the previous level (from cantIN). The intervals of internal nodes are set below level by level.
+		#pragma omp parallel for
+		for (i=0; i<leaves; i++){
+			const ulong leaf = i < leavesBottom ? firstLeaf + i : cantIN + i - leavesBottom;
+			auxL[leaf] = i*BLK;
+			auxR[leaf] = (i+1)*BLK - 1;
 		}
-		if (cont)
-			auxR[node] = i;
-	}
-
-	if (false && TRACE && leaves>0){
-		cout << endl << "min-max Intervals..." << endl;
-		for (i=0; i<cantN; i++)
-			cout << "[" << auxL[i] << "," << auxR[i] << "] ";
-		cout << endl;
 	}
 
 	int MIN_BCK = 0;
 	if (leaves){
-		ulong segment;
-		long long int currSumBck;
 		Aux_BkM = new int[cantIN];
 		MIN_BCK = 1;
 
-		for(i=cantIN; i>0; i--){
-			child = i<<1;		// child is the second child of node i
-			if (child > cantIN){
-				if (child > firstLeaf)
-					node = child - firstLeaf;
-				else
-					node = child - cantIN + leavesBottom;
-				currSumBck = 0;
-				miniBck = 0; // this 'min' correspond to the maximum level in the tree
-				for (j=0, rb=N8W64-1; j<N8BLK; j++){
-					segment = (P[((node+1)*BLK-1-BST*j)>>BW64] & RMMMasks[rb]) >> (W64m8-BST*rb);
-
-					if (currSumBck + T_MIN_BCK[segment] > miniBck)
-						miniBck = currSumBck + T_MIN_BCK[segment];
-					currSumBck += T_SUM_BLOCK[segment];
-					if (rb == 0) rb=N8W64-1;
-					else rb--;
-				}
-				for (j=0, rb=N8W64-1; j<N8BLK; j++){
-					segment = (P[(node*BLK-1-BST*j)>>BW64] & RMMMasks[rb]) >> (W64m8-BST*rb);
-
-					if (currSumBck + T_MIN_BCK[segment] > miniBck)
-						miniBck = currSumBck + T_MIN_BCK[segment];
-					currSumBck += T_SUM_BLOCK[segment];
-					if (rb == 0) rb=N8W64-1;
-					else rb--;
-				}
-			}else{
-				miniBck = Aux_BkM[child];
-				currSumBck = sumAtPos(auxR[child]) - sumAtPos(auxL[child]-1);
-				if (currSumBck + Aux_BkM[child-1] > miniBck)
-					miniBck = currSumBck + Aux_BkM[child-1];
+		// the nodes of one level are independent, the children of node i-1 are child-1 and child = i<<1
+		for(long long int level = cantIN ? 63 - __builtin_clzll(cantIN) : -1; level >= 0; level--){
+			const ulong levelBeg = 1ull << level;
+			const ulong levelEnd = min((ulong) cantIN, (2ull << level) - 1);
+			#pragma omp parallel for private(child, node, miniBck) reduction(max:MIN_BCK)
+			for(i=levelBeg; i<=levelEnd; i++){
+				ulong segment, rb, j;
+				long long int currSumBck;
+				child = i<<1;		// child is the second child of node i
+				auxL[i-1] = auxL[child-1];
+				auxR[i-1] = auxR[child];
+				if (child > cantIN){
+					if (child > firstLeaf)
+						node = child - firstLeaf;
+					else
+						node = child - cantIN + leavesBottom;
+					currSumBck = 0;
+					miniBck = 0; // this 'min' correspond to the maximum level in the tree
+					for (j=0, rb=N8W64-1; j<N8BLK; j++){
+						segment = (P[((node+1)*BLK-1-BST*j)>>BW64] & RMMMasks[rb]) >> (W64m8-BST*rb);
+
+						if (currSumBck + T_MIN_BCK[segment] > miniBck)
+							miniBck = currSumBck + T_MIN_BCK[segment];
+						currSumBck += T_SUM_BLOCK[segment];
+						if (rb == 0) rb=N8W64-1;
+						else rb--;
+					}
+					for (j=0, rb=N8W64-1; j<N8BLK; j++){
+						segment = (P[(node*BLK-1-BST*j)>>BW64] & RMMMasks[rb]) >> (W64m8-BST*rb);
+
+						if (currSumBck + T_MIN_BCK[segment] > miniBck)
+							miniBck = currSumBck + T_MIN_BCK[segment];
+						currSumBck += T_SUM_BLOCK[segment];
+						if (rb == 0) rb=N8W64-1;
+						else rb--;
+					}
+				}else{
+					miniBck = Aux_BkM[child];
+					currSumBck = sumAtPos(auxR[child]) - sumAtPos(auxL[child]-1);
+					if (currSumBck + Aux_BkM[child-1] > miniBck)
+						miniBck = currSumBck + Aux_BkM[child-1];
 
+				}
+				Aux_BkM[i-1] = miniBck;
+				if (miniBck > MIN_BCK)
+					MIN_BCK = miniBck;
 			}
-			Aux_BkM[i-1] = miniBck;
-			if (miniBck > MIN_BCK)
-				MIN_BCK = miniBck;
-
 		}
 		//cout << "Deleting auxL[] and auxR[]..." << endl;
 		delete [] auxL;
@@ -509,11 +462,9 @@ void RMQRMM64::createMinMaxTree(){
 		sizeDS = sizeDS*sizeof(ulong);
 		sizeRMM += sizeDS;
 
-		ulong cMIN_BCK = 0; // count
-		for(i=0; i<cantIN; i++){
-			setNum64(BkM, cMIN_BCK, lgBkM, Aux_BkM[i]);
-			cMIN_BCK += lgBkM;
-		}
+		#pragma omp parallel for schedule(static, W64)
+		for(i=0; i<cantIN; i++)
+			setNum64(BkM, i*lgBkM, lgBkM, Aux_BkM[i]);
 		//cout << "Deleting Aux_BkM[]..." << endl;
 		delete [] Aux_BkM;
 	}else
@@ -544,24 +495,28 @@ void RMQRMM64::createMinMaxTree(){
 
 void RMQRMM64::createTables(){
 	ulong sizeDS, MAX_B, MAX_SumB, semiSum;
-	ulong i, j, jSS, cont, rb, segment, posBLK, rOnes, nextSa;
-	long long int semiSumBlock, Min, auxMin;
+	ulong i, cont;
+	long long int *semiSums;
 
 	nBLK = nP/BLK;
 	//cout << "nBLK " << nBLK << endl;
 
 	lenSS = (nP/2)/SS+1;
 	//cout << "lenSS " << lenSS << endl;
-	posBLK = semiSum = MAX_B = MAX_SumB = 0;
+	semiSum = MAX_B = MAX_SumB = 0;
 
 	// here.... always sum >= 0, because is a BP sequence
+	// the blocks are independent, semiSums[i] is the excess of block i and later the global excess to the end of block i
+	semiSums = new long long int[nBLK];
+	ulong *TMinBlock = new ulong[nBLK];
+	#pragma omp parallel for reduction(max:MAX_B)
 	for (i=0; i<nBLK; i++){
-		semiSumBlock = Min = 0;
-		rb=N8W64-1;
-		for (j=N8BLK; j>0; j--){
-			segment = (P[(i*BLK+BST*(j-1))/W64] & RMMMasks[rb]) >> (W64m8-BST*rb);
+		long long int semiSumBlock = 0, Min = 0;
+		ulong rb=N8W64-1;
+		for (ulong j=N8BLK; j>0; j--){
+			ulong segment = (P[(i*BLK+BST*(j-1))/W64] & RMMMasks[rb]) >> (W64m8-BST*rb);
 			//printBitsUlong(segment);cout<<endl;
-			auxMin = semiSumBlock + T_MIN_BCK[segment];
+			long long int auxMin = semiSumBlock + T_MIN_BCK[segment];
 			if(auxMin > Min)
 				Min = auxMin;
 
@@ -569,13 +524,16 @@ void RMQRMM64::createTables(){
 			if (rb == 0) rb=N8W64-1;
 			else rb--;
 		}
-		semiSumBlock >>= 1;
-		semiSum += semiSumBlock;
-		if (semiSum > MAX_SumB)
-			MAX_SumB = semiSum;
+		semiSums[i] = semiSumBlock >> 1;
+		TMinBlock[i] = Min;
 		if (Min > (int)MAX_B)
 			MAX_B = Min;
-		posBLK += BLK;
+	}
+	for (i=0; i<nBLK; i++){
+		semiSum += semiSums[i];
+		semiSums[i] = semiSum;
+		if (semiSum > MAX_SumB)
+			MAX_SumB = semiSum;
 	}
 
 	MAX_B++;
@@ -594,11 +552,10 @@ void RMQRMM64::createTables(){
 	sizeDS = cont*sizeof(ulong);
 	sizeRMM += sizeDS;
 	if (TRACE || SHOW_SIZE) cout << " ** size of TSumB[] " <<  sizeDS << " Bytes" << endl;
-	setNum64(TSumB, 0, lg_SumB, 0);
 
 	if(nBLK){
-		cont = leaves*lg_MinB/W64;
-		if ((leaves*lg_MinB)%W64)
+		cont = nBLK*lg_MinB/W64;
+		if ((nBLK*lg_MinB)%W64)
 			cont++;
 		TMinB = new ulong[cont];
 		sizeDS = cont*sizeof(ulong);
@@ -621,39 +578,31 @@ void RMQRMM64::createTables(){
 	}else
 		if (TRACE || SHOW_SIZE) cout << " ** size of TSS[] 0 Bytes" << endl;
 
-	posBLK = semiSum = 0;
-	nextSa = SS;
-	jSS = 1;
-	for (i=0; i<nBLK; i++){
-		semiSumBlock = Min = 0;
-		rb=N8W64-1;
-		for (j=N8BLK; j>0; j--){
-			segment = (P[(i*BLK+BST*(j-1))/W64] & RMMMasks[rb]) >> (W64m8-BST*rb);
-			auxMin = semiSumBlock + T_MIN_BCK[segment];
-			if(auxMin > Min)
-				Min = auxMin;
-			semiSumBlock += T_SUM_BLOCK[segment];
-			if (rb == 0) rb=N8W64-1;
-			else rb--;
-		}
-		semiSumBlock >>= 1;
-		semiSum += semiSumBlock;
-		setNum64(TSumB, (i+1)*lg_SumB, lg_SumB, semiSum);
-		setNum64(TMinB, i*lg_MinB, lg_MinB, Min);
-
-		posBLK += BLK;
-		rOnes = semiSum + (posBLK/2);
-		//cout << "rOnes " << rOnes << " SB " << jS << " position " << posMin << endl;
-		while (jSS*SS <= rOnes && jSS < (ulong)lenSS){
-			setNum64(TSS, jSS*lg_SS, lg_SS, i);
-			nextSa += SS;
-			jSS++;
+	// chunks of 64 cells cover whole words of the tables, so threads never write to the same word
+	#pragma omp parallel for schedule(static, W64)
+	for (i=0; i<=nBLK; i++)
+		setNum64(TSumB, i*lg_SumB, lg_SumB, i ? semiSums[i-1] : 0);
+	#pragma omp parallel for schedule(static, W64)
+	for (i=0; i<nBLK; i++)
+		setNum64(TMinB, i*lg_MinB, lg_MinB, TMinBlock[i]);
+	delete [] TMinBlock;
+
+	// TSS[jSS] is the first block i such that the number of ones to the end of block i is at least jSS*SS (or nBLK)
+	#pragma omp parallel for schedule(static, W64)
+	for (ulong jSS=0; jSS<(ulong)lenSS; jSS++){
+		if (jSS == 0)
+			continue;
+		ulong l = 0, r = nBLK;
+		while (l < r){
+			ulong m = (l + r) >> 1;
+			if (semiSums[m] + ((m+1)*BLK/2) >= jSS*SS)
+				r = m;
+			else
+				l = m + 1;
 		}
+		setNum64(TSS, jSS*lg_SS, lg_SS, l);
 	}
-	while (jSS < (ulong)lenSS){
-		setNum64(TSS, jSS*lg_SS, lg_SS, i);
-		jSS++;
-	}
+	delete [] semiSums;
 
 	if (TRACE){
 		cout << endl << "TMinB[1.." <<nBLK<< "]... ";
@@ -675,8 +624,95 @@ void RMQRMM64::createTables(){
 // ********************************* BASIC OPERATIONS ****************************
 
 
+#ifdef RMM_WORD_OPS
+// *******************************************************************************
+// ************************ WORD AT A TIME OPERATIONS ****************************
+// The bits of P are stored from left to right, so the backward scans of the blocks go from the least significant bit.
+
+// number of ones in P[x..i], x is the first bit of a word
+static inline ulong onesInRange(const ulong *P, ulong x, ulong i){
+	ulong ones = 0, b = x>>BW64;
+	const ulong last = i>>BW64;
+	for (; b<last; b++)
+		ones += __builtin_popcountll(P[b]);
+	return ones + __builtin_popcountll(P[last] >> (W64minusone-i%W64));
+}
+
+// position (from the left) of the k-th one (k >= 1) in w
+static inline uint selectInWord(ulong w, uint k){
+#ifdef __BMI2__
+	return W64minusone - __builtin_ctzll(_pdep_u64(1ull << (__builtin_popcountll(w)-k), w));
+#else
+	for (k = __builtin_popcountll(w)-k; k; k--)
+		w &= w-1;
+	return W64minusone - __builtin_ctzll(w);
+#endif
+}
+
+// scans the len lowest bits of w from the least significant one, adding 1 for each one and -1 for each zero.
+// Returns the maximum running sum (0 for an empty prefix), sets *pos to the first bit where it is reached
+// and *excess to the total sum. The running sums are computed for 64 bits at once as bytes of two AVX2 registers.
+static inline int backwardMaxExcess(ulong w, uint len, int *excess, uint *pos){
+	const __m256i spread = _mm256_setr_epi8(0,0,0,0,0,0,0,0, 1,1,1,1,1,1,1,1, 2,2,2,2,2,2,2,2, 3,3,3,3,3,3,3,3);
+	const __m256i bitMask = _mm256_set1_epi64x(0x8040201008040201ll);
+	const __m256i ones = _mm256_set1_epi8(1);
+	const __m256i idx = _mm256_setr_epi8(0,1,2,3,4,5,6,7, 8,9,10,11,12,13,14,15,
+			16,17,18,19,20,21,22,23, 24,25,26,27,28,29,30,31);
+	if (len < W64)
+		w &= (1ull << len) - 1;
+	const int pcLo = __builtin_popcount((uint) w);
+	*excess = 2*__builtin_popcountll(w) - (int)len;
+
+	// negated steps: -1 for one and 1 for zero, so the maximum becomes the minimum of signed bytes
+	__m256i lo = _mm256_shuffle_epi8(_mm256_set1_epi32((uint) w), spread);
+	__m256i hi = _mm256_shuffle_epi8(_mm256_set1_epi32((uint) (w >> 32)), spread);
+	lo = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_and_si256(lo, bitMask), bitMask), ones);
+	hi = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_and_si256(hi, bitMask), bitMask), ones);
+	lo = _mm256_add_epi8(lo, _mm256_slli_si256(lo, 1));
+	hi = _mm256_add_epi8(hi, _mm256_slli_si256(hi, 1));
+	lo = _mm256_add_epi8(lo, _mm256_slli_si256(lo, 2));
+	hi = _mm256_add_epi8(hi, _mm256_slli_si256(hi, 2));
+	lo = _mm256_add_epi8(lo, _mm256_slli_si256(lo, 4));
+	hi = _mm256_add_epi8(hi, _mm256_slli_si256(hi, 4));
+	lo = _mm256_add_epi8(lo, _mm256_slli_si256(lo, 8));
+	hi = _mm256_add_epi8(hi, _mm256_slli_si256(hi, 8));
+	const __m256i last = _mm256_set1_epi8(15);
+	lo = _mm256_add_epi8(lo, _mm256_permute2x128_si256(_mm256_shuffle_epi8(lo, last), lo, 0x08));
+	hi = _mm256_add_epi8(hi, _mm256_permute2x128_si256(_mm256_shuffle_epi8(hi, last), hi, 0x08));
+	hi = _mm256_add_epi8(hi, _mm256_set1_epi8((char) (32 - 2*pcLo)));
+
+	// bits out of len do not count
+	const __m256i lenV = _mm256_set1_epi8((char) (len - 1));
+	const __m256i none = _mm256_set1_epi8(127);
+	lo = _mm256_blendv_epi8(lo, none, _mm256_cmpgt_epi8(idx, lenV));
+	hi = _mm256_blendv_epi8(hi, none, _mm256_cmpgt_epi8(_mm256_add_epi8(idx, _mm256_set1_epi8(32)), lenV));
+
+	__m128i m = _mm_min_epi8(_mm256_castsi256_si128(_mm256_min_epi8(lo, hi)), _mm256_extracti128_si256(_mm256_min_epi8(lo, hi), 1));
+	m = _mm_min_epi8(m, _mm_shuffle_epi32(m, 0x4E));
+	m = _mm_min_epi8(m, _mm_shuffle_epi32(m, 0xB1));
+	m = _mm_min_epi8(m, _mm_shufflelo_epi16(m, 0xB1));
+	m = _mm_min_epi8(m, _mm_srli_epi16(m, 8));
+	const int minNeg = (char) _mm_cvtsi128_si32(m);
+	if (minNeg >= 0){
+		*pos = 0;
+		return 0;
+	}
+	const __m256i minV = _mm256_set1_epi8((char) minNeg);
+	const uint maskLo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, minV));
+	*pos = maskLo ? __builtin_ctz(maskLo) : 32 + __builtin_ctz(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, minV)));
+	return -minNeg;
+}
+#endif
+
 // give the excess from 0 to pos
 long long int RMQRMM64::sumAtPos(long long int pos){
+#ifdef RMM_WORD_OPS
+	ulong blk = pos>>BBLK;
+	long long int j = blk<<BBLK, sum=getNum64(TSumB, blk*lg_SumB, lg_SumB)<<1;
+	if (j <= pos)
+		sum += 2*(long long int)onesInRange(P, j, pos) - (pos-j+1);
+	return sum;
+#else
 	ulong rb, q;
 	ulong blk = pos>>BBLK;
 	long long int j, l, sum=getNum64(TSumB, blk*lg_SumB, lg_SumB)<<1;
@@ -703,6 +739,7 @@ long long int RMQRMM64::sumAtPos(long long int pos){
 	}
 
 	return sum;
+#endif
 }
 
 void RMQRMM64::test_sumAtPos(){
@@ -750,6 +787,11 @@ ulong RMQRMM64::rank_1(ulong i){
 	ulong rank = (blk<<BMBLK) + getNum64(TSumB, blk*lg_SumB, lg_SumB);
 
 	ulong x = blk<<BBLK;
+#ifdef RMM_WORD_OPS
+	if (x <= i)
+		rank += onesInRange(P, x, i);
+	return rank;
+#else
 	while(x+BSTMOne <= i){
 		b = x>>BW64;
 		rest = ((x+BST)%W64);
@@ -766,6 +808,7 @@ ulong RMQRMM64::rank_1(ulong i){
 	}
 
 	return rank;
+#endif
 }
 
 void RMQRMM64::test_rank_1(){
@@ -829,6 +872,17 @@ ulong RMQRMM64::select_1(ulong i){
 		}
 	}
 
+#ifdef RMM_WORD_OPS
+	// Accumulate sum word by word
+	b = j>>BW64;
+	q = __builtin_popcountll(P[b]);
+	while(r+q < i){
+		r += q;
+		b++;
+		q = __builtin_popcountll(P[b]);
+	}
+	return (b<<BW64) + selectInWord(P[b], i-r);
+#else
 	// Accumulate sum block by block
 	b = j>>BW64;
 	s = (j+BST)%W64;
@@ -852,6 +906,7 @@ ulong RMQRMM64::select_1(ulong i){
 	}
 
 	return j-1;
+#endif
 }
 
 void RMQRMM64::test_select_1(){
@@ -898,6 +953,16 @@ long long int RMQRMM64::sumAtBlock(long long int blk){
 
 // return the position in the block 'blk' where is the minimum 'Min' of the block
 ulong RMQRMM64::positionMinblock(ulong blk){
+#ifdef RMM_WORD_OPS
+	int sum = 0, excess;
+	uint pos;
+	const int Min = getNum64(TMinB, blk*lg_MinB, lg_MinB);
+	for (ulong x = ((blk+1)<<BBLK)-1; ; x -= W64){
+		if (backwardMaxExcess(P[x>>BW64], W64, &excess, &pos) + sum == Min)
+			return x-pos;
+		sum += excess;
+	}
+#else
 	int sum, min, Min;
 	uint rest, q, rb;
 	ulong b, posMin, x;
@@ -928,6 +993,7 @@ ulong RMQRMM64::positionMinblock(ulong blk){
 	posMin = x-T_BCK_D[q][min-1];
 
 	return posMin;
+#endif
 }
 
 void RMQRMM64::test_positionMinblock(){
@@ -1072,6 +1138,26 @@ ulong RMQRMM64::computeLeavesOfNode(ulong node, ulong dist){
 
 // search the rightmost minimum from x2 to x1 (sequential search)
 void RMQRMM64::search_min_block(ulong x1, ulong x2, long long int *min, long long int *curSum, ulong *position){
+#ifdef RMM_WORD_OPS
+	long long int Min = *min, sum = *curSum;
+	ulong lo, posMin = *position;
+	int excess, maxExcess;
+	uint pos;
+	for (; x2+1 > x1; x2 = lo-1){
+		lo = max(x1, (x2>>BW64)<<BW64);
+		maxExcess = backwardMaxExcess(P[x2>>BW64] >> (W64minusone-x2%W64), x2-lo+1, &excess, &pos);
+		if (Min < sum+maxExcess){
+			Min = sum+maxExcess;
+			posMin = x2-pos;
+		}
+		sum += excess;
+		if (lo == 0)
+			break;
+	}
+	*curSum = sum;
+	*min = Min;
+	*position = posMin;
+#else
 	int Min, sum, auxMin;
 	uint rest, q;
 	ulong b, len = x2-x1+1, posMin = *position;
@@ -1111,6 +1197,7 @@ void RMQRMM64::search_min_block(ulong x1, ulong x2, long long int *min, long lon
 	*curSum = sum;
 	*min = Min;
 	*position = posMin;
+#endif
 }
 
 void RMQRMM64::test_search_min_block(){
@@ -1739,6 +1826,7 @@ RMQRMM64::~RMQRMM64() {
 	if(cantIN) delete [] BkM;
 	if(lenSS) delete [] TSS;
 	if(nBLK) delete [] TMinB;
+	if(streamQFile) fclose(streamQFile);
 
 	cout << " ~ RMQRMM64 destroyed !!" << endl;
 }
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include "batchrmq.h"
+#include "utils/testdata.h"
+#include "utils/timer.h"
+
+#include <omp.h>
+
+bool BatchRMQCostModel::load(const string &fileName) {
+    ifstream fin(fileName);
+    if (!fin)
+        return false;
+    string line;
+    while (getline(fin, line)) {
+        line = line.substr(0, line.find('#'));
+        const size_t eqPos = line.find('=');
+        if (eqPos == string::npos)
+            continue;
+        string key, value;
+        stringstream(line.substr(0, eqPos)) >> key;
+        stringstream(line.substr(eqPos + 1)) >> value;
+        if (key == "bbst_build_per_element")
+            bbstBuildPerElement = atof(value.c_str());
+        else if (key == "bbst_query")
+            bbstQuery = atof(value.c_str());
+        else if (key == "bbstcon_per_element")
+            bbstconPerElement = atof(value.c_str());
+        else if (key == "bbstcon_query")
+            bbstconQuery = atof(value.c_str());
+        else if (key == "bbstcon_sorting")
+            sortingAlg = (sortingAlg_enum) value[0];
+        else if (key == "threads")
+            threads = atoi(value.c_str());
+        else if (key == "bbst_k_exp")
+            bbstKExp = atoi(value.c_str());
+        else if (key == "bbst_mini_k_exp")
+            bbstMiniKExp = atoi(value.c_str());
+        else if (key == "bbstcon_k_exp")
+            bbstconKExp = atoi(value.c_str());
+        else
+            fprintf(stderr, "Unknown cost model parameter %s in %s\n", key.c_str(), fileName.c_str());
+    }
+    return true;
+}
+
+void BatchRMQCostModel::save(const string &fileName) {
+    fstream fout(fileName, ios::out);
+    fout << "# BatchRMQ cost model [ns] (see batchrmq.h)" << std::endl;
+    fout << "bbst_build_per_element = " << bbstBuildPerElement << std::endl;
+    fout << "bbst_query = " << bbstQuery << std::endl;
+    fout << "bbstcon_per_element = " << bbstconPerElement << std::endl;
+    fout << "bbstcon_query = " << bbstconQuery << std::endl;
+    fout << "bbstcon_sorting = " << (char) sortingAlg << std::endl;
+    fout << "threads = " << threads << std::endl;
+    fout << "bbst_k_exp = " << bbstKExp << std::endl;
+    fout << "bbst_mini_k_exp = " << bbstMiniKExp << std::endl;
+    fout << "bbstcon_k_exp = " << bbstconKExp << std::endl;
+}
+
+#ifdef MINI_BLOCKS
+BatchRMQ::BatchRMQ(const BatchRMQCostModel &model, int bbstKExp, int bbstMiniKExp, int bbstconKExp):
+        model(model), bbstKExp(bbstKExp), bbstMiniKExp(bbstMiniKExp), bbstconKExp(bbstconKExp), bbstcon(model.sortingAlg, bbstconKExp) {
+}
+#else
+BatchRMQ::BatchRMQ(const BatchRMQCostModel &model, int bbstKExp, int bbstconKExp):
+        model(model), bbstKExp(bbstKExp), bbstMiniKExp(0), bbstconKExp(bbstconKExp), bbstcon(model.sortingAlg, bbstconKExp) {
+}
+#endif
+
+BatchRMQ::~BatchRMQ() {
+    invalidate();
+}
+
+void BatchRMQ::invalidate() {
+    delete bbst;
+    bbst = 0;
+    valuesArray = 0;
+    n = 0;
+    bbstconSpentCost = 0;
+}
+
+double BatchRMQ::sortFactor(sortingAlg_enum sortingAlg, const size_t q) {
+    if (sortingAlg == kxradixsort || sortingAlg == ompradixsort)
+        return 1;
+    return log2(2.0 * q);
+}
+
+double BatchRMQ::bbstCost(const t_array_size n, const size_t q, bool withBuild) {
+    return (withBuild ? model.bbstBuildPerElement * n : 0) + model.bbstQuery * q;
+}
+
+double BatchRMQ::bbstconCost(const t_array_size n, const size_t q) {
+    return model.bbstconPerElement * n + model.bbstconQuery * q * sortFactor(model.sortingAlg, q);
+}
+
+void BatchRMQ::rmqBatch(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries, t_array_size *resultLoc) {
+    if (valuesArray != this->valuesArray || n != this->n) {
+        invalidate();
+        this->valuesArray = valuesArray;
+        this->n = n;
+    }
+    const size_t q = queries.size() / 2;
+    if (q == 0)
+        return;
+    const double conCost = bbstconCost(n, q);
+    if (!bbst && (bbstCost(n, q, true) <= conCost || bbstconSpentCost + conCost >= model.bbstBuildPerElement * n)) {
+#ifdef MINI_BLOCKS
+        bbst = new BbST(valuesArray, n, bbstKExp, bbstMiniKExp);
+#else
+        bbst = new BbST(valuesArray, n, bbstKExp);
+#endif
+    }
+    if (bbst && bbstCost(n, q, false) <= conCost) {
+        lastEngineUsed = bbstEngine;
+        bbst->rmqBatch(queries, resultLoc);
+    } else {
+        lastEngineUsed = bbstconEngine;
+        bbstcon.rmqBatch(valuesArray, n, queries, resultLoc);
+        bbstconSpentCost += conCost;
+    }
+}
+
+size_t BatchRMQ::memUsageInBytes() {
+    return bbst ? bbst->memUsageInBytes() : 0;
+}
+
+#ifdef MINI_BLOCKS
+BatchRMQCostModel BatchRMQ::calibrate(sortingAlg_enum sortingAlg, int bbstKExp, int bbstMiniKExp, int bbstconKExp, const t_array_size n) {
+#else
+BatchRMQCostModel BatchRMQ::calibrate(sortingAlg_enum sortingAlg, int bbstKExp, int bbstconKExp, const t_array_size n) {
+    const int bbstMiniKExp = 0;
+#endif
+    if (n == 0)
+        throw std::invalid_argument("BatchRMQ: calibration requires a non-empty array");
+    BatchRMQCostModel model;
+    model.sortingAlg = sortingAlg;
+    model.threads = omp_get_max_threads();
+    model.bbstKExp = bbstKExp;
+    model.bbstMiniKExp = bbstMiniKExp;
+    model.bbstconKExp = bbstconKExp;
+    ChronoStopWatch timer;
+    vector<t_value> valuesArray(n);
+    getPermutationOfRange(valuesArray);
+    // distinct non-empty batch sizes (also for small n), so that largeWork > smallWork
+    const size_t smallQ = max<size_t>(n / 1024, 1), largeQ = max<size_t>(n / 8, 2 * smallQ);
+    vector<pair<t_array_size, t_array_size>> queriesPairs(largeQ);
+    getRandomRangeQueries(queriesPairs, n, n);
+    const vector<t_array_size> largeQueries = flattenQueries(queriesPairs, largeQ);
+    const vector<t_array_size> smallQueries(largeQueries.begin(), largeQueries.begin() + 2 * smallQ);
+    vector<t_array_size> resultLoc(largeQ);
+
+    timer.startTimer();
+#ifdef MINI_BLOCKS
+    BbST bbst(&valuesArray[0], n, bbstKExp, bbstMiniKExp);
+#else
+    BbST bbst(&valuesArray[0], n, bbstKExp);
+#endif
+    timer.stopTimer();
+    model.bbstBuildPerElement = timer.getElapsedTime() * 1e9 / n;
+    timer.startTimer();
+    bbst.rmqBatch(largeQueries, &resultLoc[0]);
+    timer.stopTimer();
+    model.bbstQuery = timer.getElapsedTime() * 1e9 / largeQ;
+
+    // BbSTcon time = perElement * n + query * q * sortFactor(q) fitted from two batch sizes (best of 2 runs)
+    BbSTcon bbstcon(sortingAlg, bbstconKExp);
+    double smallTime = MAX_T_VALUE, largeTime = MAX_T_VALUE;
+    for (int i = 0; i < 2; i++) {
+        timer.startTimer();
+        bbstcon.rmqBatch(&valuesArray[0], n, smallQueries, &resultLoc[0]);
+        timer.stopTimer();
+        smallTime = min(smallTime, timer.getElapsedTime() * 1e9);
+        timer.startTimer();
+        bbstcon.rmqBatch(&valuesArray[0], n, largeQueries, &resultLoc[0]);
+        timer.stopTimer();
+        largeTime = min(largeTime, timer.getElapsedTime() * 1e9);
+    }
+    const double smallWork = smallQ * sortFactor(sortingAlg, smallQ);
+    const double largeWork = largeQ * sortFactor(sortingAlg, largeQ);
+    model.bbstconQuery = max(0.0, (largeTime - smallTime) / (largeWork - smallWork));
+    model.bbstconPerElement = max(0.0, (smallTime - model.bbstconQuery * smallWork) / n);
+    return model;
+}
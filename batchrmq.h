@@ -0,0 +1,88 @@
+#ifndef BATCHRMQ_H
+#define BATCHRMQ_H
+
+#include <vector>
+#include "common.h"
+#include "bbst.h"
+#include "bbstcon.h"
+
+using namespace std;
+
+// Linear cost model [ns] of answering a batch of q queries over n elements:
+//   BbST:    bbstBuildPerElement * n (unless the instance for the array is kept) + bbstQuery * q
+//   BbSTcon: bbstconPerElement * n + bbstconQuery * q * sortFactor(q)
+// where sortFactor is log2(2q) for comparison sorts and 1 for radix sorts of the bounds.
+// Config file: one "key = value" line per parameter (# starts a comment), written by BatchRMQ::calibrate.
+// The costs hold for the block size exponents and the number of threads they were measured with.
+struct BatchRMQCostModel {
+    double bbstBuildPerElement = 2.0;
+    double bbstQuery = 150.0;
+    double bbstconPerElement = 1.0;
+    double bbstconQuery = 300.0;
+    sortingAlg_enum sortingAlg = kxradixsort;
+    int threads = 1;
+    int bbstKExp = 12;
+    int bbstMiniKExp = 7;
+    int bbstconKExp = 9;
+
+    bool load(const string &fileName);
+    void save(const string &fileName);
+};
+
+enum batchEngine_enum {
+    bbstEngine = 'b',
+    bbstconEngine = 'c'
+};
+
+// Batch RMQ front end which answers each batch with the engine of lower estimated cost.
+// The BbST instance is kept for the array once built. It is built when its build and queries cost less than
+// BbSTcon for the batch, or when the estimated cost of the batches already answered by BbSTcon on the array
+// reaches the build cost (repeated batches amortize the build).
+// The array is identified by its address and size; invalidate() has to be called after its values change.
+class BatchRMQ {
+public:
+#ifdef MINI_BLOCKS
+    BatchRMQ(const BatchRMQCostModel &model, int bbstKExp = 12, int bbstMiniKExp = 7, int bbstconKExp = 9);
+#else
+    BatchRMQ(const BatchRMQCostModel &model, int bbstKExp = 12, int bbstconKExp = 9);
+#endif
+
+    virtual ~BatchRMQ();
+
+    void rmqBatch(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries, t_array_size *resultLoc);
+    void invalidate();
+
+    // estimated costs [ns] of the next batch of q queries over the array
+    double bbstCost(const t_array_size n, const size_t q, bool withBuild);
+    double bbstconCost(const t_array_size n, const size_t q);
+
+    batchEngine_enum lastEngine() { return lastEngineUsed; }
+
+    size_t memUsageInBytes();
+
+    // measures BbST and BbSTcon (with sortingAlg and the given block size exponents) on random data and fits the model
+    // (for the current number of threads)
+#ifdef MINI_BLOCKS
+    static BatchRMQCostModel calibrate(sortingAlg_enum sortingAlg, int bbstKExp = 12, int bbstMiniKExp = 7, int bbstconKExp = 9,
+            const t_array_size n = 1 << 24);
+#else
+    static BatchRMQCostModel calibrate(sortingAlg_enum sortingAlg, int bbstKExp = 12, int bbstconKExp = 9,
+            const t_array_size n = 1 << 24);
+#endif
+
+private:
+    BatchRMQCostModel model;
+    int bbstKExp, bbstMiniKExp, bbstconKExp;
+
+    const t_value* valuesArray = 0;
+    t_array_size n = 0;
+    BbST* bbst = 0;
+    BbSTcon bbstcon;
+    double bbstconSpentCost = 0;
+    batchEngine_enum lastEngineUsed = bbstconEngine;
+
+    static double sortFactor(sortingAlg_enum sortingAlg, const size_t q);
+};
+
+
+#endif //BATCHRMQ_H
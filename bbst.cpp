@@ -1,11 +1,16 @@
 #include <algorithm>
 #include <iostream>
 #include <numeric>
+#include <stdexcept>
 #include "bbst.h"
 #include <omp.h>
 
 #ifdef MINI_BLOCKS
 BbST::BbST(int kExp, int miniKExp) {
+#ifdef MINI_MASKS
+    if (miniKExp > CT_BLOCK_EXP)
+        throw std::invalid_argument("BbST: miniblock masks require miniblock size <= 64");
+#endif
     this->miniKExp = miniKExp;
     this->miniK = 1 << miniKExp;
 #else
@@ -24,6 +29,9 @@ void BbST::rmqBatch(const t_value* valuesArray, const t_array_size n, const vect
     this->n = n;
     getBlocksMinsBase();
     getBlocksSparseTable();
+#ifdef RESULT_CACHE
+    resultCache.clear();
+#endif
     this->rmqBatch(queries, resultLoc);
     cleanup();
 /**/
@@ -31,6 +39,10 @@ void BbST::rmqBatch(const t_value* valuesArray, const t_array_size n, const vect
 
 #ifdef MINI_BLOCKS
 BbST::BbST(const t_value* valuesArray, const t_array_size n, int kExp, int miniKExp) {
+#ifdef MINI_MASKS
+    if (miniKExp > CT_BLOCK_EXP)
+        throw std::invalid_argument("BbST: miniblock masks require miniblock size <= 64");
+#endif
     this->miniKExp = miniKExp;
     this->miniK = 1 << miniKExp;
 #else
@@ -45,25 +57,125 @@ BbST::BbST(const t_value* valuesArray, const t_array_size n, int kExp) {
     getBlocksSparseTable();
 }
 
+BbST::BbST(const BbST &source, int numaNode) {
+    this->valuesArray = source.valuesArray;
+    this->n = source.n;
+    this->kExp = source.kExp;
+    this->k = source.k;
+    this->miniKExp = source.miniKExp;
+    this->miniK = source.miniK;
+    this->blocksCount = source.blocksCount;
+    this->D = source.D;
+    this->batchMode = true;
+    const t_array_size blocksSize = blocksCount * D;
+    blocksVal2D = allocTable<t_value>(blocksSize, numaNode);
+    blocksLoc2D = allocTable<t_array_size>(blocksSize, numaNode);
+    std::copy(source.blocksVal2D, source.blocksVal2D + blocksSize, blocksVal2D);
+    std::copy(source.blocksLoc2D, source.blocksLoc2D + blocksSize, blocksLoc2D);
+#ifdef MINI_BLOCKS
+    this->miniBlocksCount = source.miniBlocksCount;
+    this->miniBlocksInBlock = source.miniBlocksInBlock;
+    this->miniBlocksLoc = allocTable<uint8_t>(miniBlocksCount, numaNode);
+    std::copy(source.miniBlocksLoc, source.miniBlocksLoc + miniBlocksCount, miniBlocksLoc);
+#endif
+#if defined(CARTESIAN_BLOCKS) || defined(MINI_MASKS)
+    this->ctKExp = source.ctKExp;
+    this->ctBlocksCount = source.ctBlocksCount;
+    this->ctPrefixMinMasks = allocTable<uint64_t>(ctBlocksCount, numaNode);
+    this->ctSuffixMinMasks = allocTable<uint64_t>(ctBlocksCount, numaNode);
+    std::copy(source.ctPrefixMinMasks, source.ctPrefixMinMasks + ctBlocksCount, ctPrefixMinMasks);
+    std::copy(source.ctSuffixMinMasks, source.ctSuffixMinMasks + ctBlocksCount, ctSuffixMinMasks);
+#endif
+}
+
 void BbST::rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc) {
     #pragma omp parallel for
     for (int i = 0; i < queries.size(); i = i + 2) {
+        RMQ_STATS_QUERY_BEGIN();
         resultLoc[i / 2] = rmq(queries[i], queries[i + 1]);
+        RMQ_STATS_QUERY_END();
+    }
+}
+
+void BbST::rmqBatchInterleaved(const vector<t_array_size> &queries, t_array_size *resultLoc, int inFlight) {
+    struct InterleavedQuery {
+        int stage;  // 0 - idle, 1 - sparse table values prefetched, 2 - location prefetched
+        t_array_size queryIdx, begIdx, endIdx, begCompIdx, endShiftCompIdx, locIdx;
+        t_array_size e;
+    };
+    const t_array_size q = queries.size() / 2;
+    #pragma omp parallel
+    {
+        const int threadsCount = omp_get_num_threads();
+        const int thread = omp_get_thread_num();
+        t_array_size nextQueryIdx = ((t_array_size_2x) q * thread) / threadsCount;
+        const t_array_size endQueryIdx = ((t_array_size_2x) q * (thread + 1)) / threadsCount;
+        vector<InterleavedQuery> slots(inFlight);
+        int active = inFlight;
+        for (int s = 0; active; s = (s + 1 == inFlight) ? 0 : s + 1) {
+            InterleavedQuery &slot = slots[s];
+            switch (slot.stage) {
+                case 0:
+                    // start the next query of the thread (single element queries are answered at once)
+                    while (nextQueryIdx < endQueryIdx && queries[2 * nextQueryIdx] == queries[2 * nextQueryIdx + 1]) {
+                        resultLoc[nextQueryIdx] = queries[2 * nextQueryIdx];
+                        nextQueryIdx++;
+                    }
+                    if (nextQueryIdx == endQueryIdx) {
+                        slot.stage = -1;
+                        active--;
+                        break;
+                    }
+                    slot.queryIdx = nextQueryIdx++;
+                    slot.begIdx = queries[2 * slot.queryIdx];
+                    slot.endIdx = queries[2 * slot.queryIdx + 1];
+                    slot.begCompIdx = slot.begIdx >> kExp;
+                    {
+                        const t_array_size endCompIdx = slot.endIdx >> kExp;
+                        const t_array_size kBlockCount = endCompIdx - slot.begCompIdx;
+                        slot.e = kBlockCount?(31 - __builtin_clz(kBlockCount)):0;
+                        slot.endShiftCompIdx = endCompIdx - (1 << slot.e) + 1;
+                    }
+                    __builtin_prefetch(&blocksVal2D[slot.begCompIdx + slot.e * blocksCount]);
+                    __builtin_prefetch(&blocksVal2D[slot.endShiftCompIdx + slot.e * blocksCount]);
+                    slot.stage = 1;
+                    break;
+                case 1:
+                    slot.locIdx = (blocksVal2D[slot.begCompIdx + slot.e * blocksCount] <= blocksVal2D[slot.endShiftCompIdx + slot.e * blocksCount]
+                            ? slot.begCompIdx : slot.endShiftCompIdx) + slot.e * blocksCount;
+                    __builtin_prefetch(&blocksLoc2D[slot.locIdx]);
+                    slot.stage = 2;
+                    break;
+                case 2: {
+                    RMQ_STATS_QUERY_BEGIN();
+#ifndef WORST_CASE
+                    const t_array_size result = blocksLoc2D[slot.locIdx];
+                    if (slot.begIdx <= result && result <= slot.endIdx)
+                        resultLoc[slot.queryIdx] = result;
+                    else
+#endif
+                        resultLoc[slot.queryIdx] = rmq(slot.begIdx, slot.endIdx);
+                    RMQ_STATS_QUERY_END();
+                    slot.stage = 0;
+                    break;
+                }
+            }
+        }
     }
 }
 
 void BbST::getBlocksMinsBase() {
 #ifdef MINI_BLOCKS
     this->miniBlocksCount = (n + miniK - 1) >> miniKExp;
-    this->miniBlocksLoc = new uint8_t[miniBlocksCount];
+    this->miniBlocksLoc = allocTable<uint8_t>(miniBlocksCount);
     t_value* miniBlocksVal= new t_value[miniBlocksCount];
     this->miniBlocksInBlock = k / miniK;
 #endif
     this->blocksCount = (n + k - 1) >> kExp;
     this->D = 32 - __builtin_clz(blocksCount);
     const t_array_size blocksSize = blocksCount * D;
-    blocksVal2D = new t_value[blocksSize];
-    blocksLoc2D = new t_array_size[blocksSize];
+    blocksVal2D = allocTable<t_value>(blocksSize);
+    blocksLoc2D = allocTable<t_array_size>(blocksSize);
 
 #ifdef MINI_BLOCKS
     #pragma omp parallel for
@@ -108,8 +220,47 @@ void BbST::getBlocksMinsBase() {
     blocksVal2D[blocksCount - 1] = *minPtr;
     blocksLoc2D[blocksCount - 1] = minPtr - &valuesArray[0];
 #endif
+#ifdef CARTESIAN_BLOCKS
+    getCartesianSignatures(CT_BLOCK_EXP);
+#elif defined(MINI_MASKS)
+    getCartesianSignatures(miniKExp);
+#endif
 }
 
+#if defined(CARTESIAN_BLOCKS) || defined(MINI_MASKS)
+void BbST::getCartesianSignatures(int ctKExp) {
+    this->ctKExp = ctKExp;
+    this->ctBlocksCount = (n + (1 << ctKExp) - 1) >> ctKExp;
+    this->ctPrefixMinMasks = allocTable<uint64_t>(ctBlocksCount);
+    this->ctSuffixMinMasks = allocTable<uint64_t>(ctBlocksCount);
+    #pragma omp parallel for
+    for (t_array_size ctI = 0; ctI < ctBlocksCount; ctI++) {
+        const t_value* block = &valuesArray[ctI << ctKExp];
+        const int blockSize = std::min((t_array_size) 1 << ctKExp, n - (ctI << ctKExp));
+        uint64_t prefixMask = 1;
+        uint64_t suffixMask = 1;
+        t_value suffixStack[1 << CT_BLOCK_EXP]; // values of suffix minima (positions are kept in suffixMask)
+        int stackTop = 0;
+        suffixStack[0] = block[0];
+        for (int i = 1; i < blockSize; i++) {
+            if (block[i] < suffixStack[0]) {
+                prefixMask |= 1ULL << i;
+                suffixMask = 0;
+                stackTop = -1;
+            }
+            while (stackTop >= 0 && suffixStack[stackTop] > block[i]) {
+                suffixMask ^= 1ULL << (63 - __builtin_clzll(suffixMask));
+                stackTop--;
+            }
+            suffixMask |= 1ULL << i;
+            suffixStack[++stackTop] = block[i];
+        }
+        ctPrefixMinMasks[ctI] = prefixMask;
+        ctSuffixMinMasks[ctI] = suffixMask;
+    }
+}
+#endif
+
 void BbST::getBlocksSparseTable() {
     for(t_array_size e = 1, step = 1; e < D; ++e, step <<= 1) {
         for (t_array_size i = 0; i < blocksCount; i++) {
@@ -126,6 +277,21 @@ void BbST::getBlocksSparseTable() {
 }
 
 t_array_size BbST::rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+#ifdef RESULT_CACHE
+    RMQResultCache::Shard* shard = resultCache.acquireShard();
+    if (!shard)
+        return uncachedRmq(begIdx, endIdx);
+    t_array_size result;
+    if (!resultCache.lookup(shard, begIdx, endIdx, result)) {
+        result = uncachedRmq(begIdx, endIdx);
+        resultCache.insert(shard, begIdx, endIdx, result);
+    }
+    resultCache.releaseShard(shard);
+    return result;
+}
+
+inline t_array_size BbST::uncachedRmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+#endif
     if (begIdx == endIdx) {
         return begIdx;
     }
@@ -195,6 +361,7 @@ t_array_size BbST::rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
 }
 
 inline t_array_size BbST::rawScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& minVal, bool smallerOrEqual) {
+    RMQ_STATS_PATH(scanPath);
     t_array_size minValIdx = begIdx;
     for(t_array_size i = begIdx + 1; i <= endIdx; i++) {
         if (valuesArray[i] < valuesArray[minValIdx]) {
@@ -209,6 +376,7 @@ inline t_array_size BbST::rawScanMinIdx(const t_array_size &begIdx, const t_arra
 }
 
 inline t_array_size BbST::miniScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& minVal, bool smallerOrEqual) {
+    RMQ_STATS_PATH(miniPath);
     const t_array_size begMiniIdx = begIdx >> miniKExp;
     const t_array_size endMiniIdx = endIdx >> miniKExp;
     const t_array_size firstMiniBlockMinLoc = (begMiniIdx << miniKExp) + miniBlocksLoc[begMiniIdx];
@@ -222,7 +390,7 @@ inline t_array_size BbST::miniScanMinIdx(const t_array_size &begIdx, const t_arr
                 return MAX_T_ARRAYSIZE;
         }
 #endif
-        return rawScanMinIdx(begIdx, endIdx, minVal, smallerOrEqual);
+        return edgeScanMinIdx(begIdx, endIdx, minVal, smallerOrEqual);
     }
     t_array_size result = MAX_T_ARRAYSIZE;
     if (endMiniIdx - begMiniIdx > 1) {
@@ -251,7 +419,7 @@ inline t_array_size BbST::miniScanMinIdx(const t_array_size &begIdx, const t_arr
         } else
 #endif
         {
-            t_array_size minIdx = rawScanMinIdx(begIdx, ((begMiniIdx + 1) << miniKExp) - 1, minVal, smallerOrEqual);
+            t_array_size minIdx = edgeScanMinIdx(begIdx, ((begMiniIdx + 1) << miniKExp) - 1, minVal, smallerOrEqual);
             if (minIdx != MAX_T_ARRAYSIZE) {
                 smallerOrEqual = false;
                 result = minIdx;
@@ -268,7 +436,7 @@ inline t_array_size BbST::miniScanMinIdx(const t_array_size &begIdx, const t_arr
         } else
 #endif
         {
-            t_array_size minIdx = rawScanMinIdx(endMiniIdx << miniKExp, endIdx, minVal, result == MAX_T_ARRAYSIZE && smallerOrEqual);
+            t_array_size minIdx = edgeScanMinIdx(endMiniIdx << miniKExp, endIdx, minVal, result == MAX_T_ARRAYSIZE && smallerOrEqual);
             if (minIdx != MAX_T_ARRAYSIZE) {
                 return minIdx;
             }
@@ -277,19 +445,86 @@ inline t_array_size BbST::miniScanMinIdx(const t_array_size &begIdx, const t_arr
     return result;
 }
 
+#if defined(CARTESIAN_BLOCKS) || defined(MINI_MASKS)
+inline t_array_size BbST::ctBlockMinIdx(const t_array_size &begIdx, const t_array_size &endIdx) {
+    const t_array_size ctIdx = begIdx >> ctKExp;
+    const t_array_size ctBegIdx = ctIdx << ctKExp;
+    t_array_size result = ctBegIdx + __builtin_ctzll(ctSuffixMinMasks[ctIdx] & (~0ULL << (begIdx - ctBegIdx)));
+    if (result <= endIdx)
+        return result;
+    result = ctBegIdx + 63 - __builtin_clzll(ctPrefixMinMasks[ctIdx] & (~0ULL >> (63 - (endIdx - ctBegIdx))));
+    if (result >= begIdx)
+        return result;
+    RMQ_STATS_PATH(scanPath);
+    result = begIdx;
+    for(t_array_size i = begIdx + 1; i <= endIdx; i++) {
+        if (valuesArray[i] < valuesArray[result]) {
+            result = i;
+        }
+    }
+    return result;
+}
+#endif
+
+#ifdef CARTESIAN_BLOCKS
+inline t_array_size BbST::ctScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& minVal, bool smallerOrEqual) {
+    RMQ_STATS_PATH(miniPath);
+    const t_array_size begCtIdx = begIdx >> ctKExp;
+    const t_array_size endCtIdx = endIdx >> ctKExp;
+    if (endCtIdx == begCtIdx)
+        return edgeScanMinIdx(begIdx, endIdx, minVal, smallerOrEqual);
+    t_array_size result = ctBlockMinIdx(begIdx, ((begCtIdx + 1) << ctKExp) - 1);
+    t_value resultVal = valuesArray[result];
+    for(t_array_size i = begCtIdx + 1; i < endCtIdx; i++) {
+        const t_array_size tempLoc = (i << ctKExp) + __builtin_ctzll(ctSuffixMinMasks[i]);
+        if (valuesArray[tempLoc] < resultVal) {
+            resultVal = valuesArray[tempLoc];
+            result = tempLoc;
+        }
+    }
+    const t_array_size tempLoc = ctBlockMinIdx(endCtIdx << ctKExp, endIdx);
+    if (valuesArray[tempLoc] < resultVal)
+        result = tempLoc;
+    if (smallerOrEqual?valuesArray[result]<=minVal:valuesArray[result]<minVal) {
+        minVal = valuesArray[result];
+        return result;
+    } else
+        return MAX_T_ARRAYSIZE;
+}
+#endif
+
+inline t_array_size BbST::edgeScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& minVal, bool smallerOrEqual) {
+#if defined(CARTESIAN_BLOCKS) || defined(MINI_MASKS)
+    const t_array_size minValIdx = ctBlockMinIdx(begIdx, endIdx);
+    if (smallerOrEqual?valuesArray[minValIdx]<=minVal:valuesArray[minValIdx]<minVal) {
+        minVal = valuesArray[minValIdx];
+        return minValIdx;
+    } else
+        return MAX_T_ARRAYSIZE;
+#else
+    return rawScanMinIdx(begIdx, endIdx, minVal, smallerOrEqual);
+#endif
+}
+
 t_array_size BbST::scanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& minVal, bool smallerOrEqual) {
 #ifdef MINI_BLOCKS
     return miniScanMinIdx(begIdx, endIdx, minVal, smallerOrEqual);
+#elif defined(CARTESIAN_BLOCKS)
+    return ctScanMinIdx(begIdx, endIdx, minVal, smallerOrEqual);
 #else
     return rawScanMinIdx(begIdx, endIdx, minVal, smallerOrEqual);
 #endif
 }
 
 void BbST::cleanup() {
-    delete[] this->blocksLoc2D;
-    delete[] this->blocksVal2D;
+    freeTable(this->blocksLoc2D);
+    freeTable(this->blocksVal2D);
 #ifdef MINI_BLOCKS
-    delete[] this->miniBlocksLoc;
+    freeTable(this->miniBlocksLoc);
+#endif
+#if defined(CARTESIAN_BLOCKS) || defined(MINI_MASKS)
+    freeTable(this->ctPrefixMinMasks);
+    freeTable(this->ctSuffixMinMasks);
 #endif
 }
 
@@ -299,6 +534,12 @@ size_t BbST::memUsageInBytes() {
     size_t bytes = blocksSize * (sizeof(t_value) + sizeof(t_array_size));
 #ifdef MINI_BLOCKS
     bytes += miniBlocksCount;
+#endif
+#if defined(CARTESIAN_BLOCKS) || defined(MINI_MASKS)
+    bytes += (size_t) ctBlocksCount * 2 * sizeof(uint64_t);
+#endif
+#ifdef RESULT_CACHE
+    bytes += resultCache.memUsageInBytes();
 #endif
     return bytes;
 }
@@ -3,26 +3,55 @@
 
 #include <vector>
 #include "common.h"
+#include "utils/rmqstats.h"
+#include "utils/tablealloc.h"
+#ifdef RESULT_CACHE
+#include "utils/resultcache.h"
+#endif
 
 using namespace std;
 
+#if defined(MINI_MASKS) && !defined(MINI_BLOCKS)
+#error "MINI_MASKS requires MINI_BLOCKS"
+#endif
+
+// with miniblocks the edge ranges of CARTESIAN_BLOCKS could span several 64-element signature blocks
+#if defined(CARTESIAN_BLOCKS) && defined(MINI_BLOCKS)
+#error "CARTESIAN_BLOCKS cannot be combined with MINI_BLOCKS (use MINI_MASKS)"
+#endif
+
+#if defined(CARTESIAN_BLOCKS) || defined(MINI_MASKS)
+#define CT_BLOCK_EXP 6 // maximal block size exponent for Cartesian tree signatures
+#endif
+
 class BbST {
 public:
 #ifdef MINI_BLOCKS
+    // with MINI_MASKS throws std::invalid_argument if miniKExp > CT_BLOCK_EXP (masks of up to 64 bits)
     BbST(const t_value* valuesArray, const t_array_size n, int kExp, int miniKExp);
     BbST(int kExp, int miniKExp);
 #else 
     BbST(const t_value* valuesArray, const t_array_size n, int kExp);
     BbST(int kExp);
 #endif
+    // replica of the tables of source bound to the NUMA node (values array is shared)
+    BbST(const BbST &source, int numaNode);
     void rmqBatch(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries, t_array_size *resultLoc);
     void rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc);
+    // interleaved batch (AMAC): each thread keeps inFlight queries and advances them stage by stage, prefetching
+    // the sparse table value and location of the next stage (queries answered outside of the sparse table use rmq)
+    void rmqBatchInterleaved(const vector<t_array_size> &queries, t_array_size *resultLoc, int inFlight);
     t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx);
 
     virtual ~BbST();
 
     size_t memUsageInBytes();
 
+#ifdef RESULT_CACHE
+    // results of the answered queries (rmq looks up the exact range before using the tables)
+    RMQResultCache &getResultCache() { return resultCache; }
+#endif
+
 private:
     t_array_size blocksCount;
     int k, kExp, D, miniK, miniKExp;
@@ -37,16 +66,35 @@ private:
     int miniBlocksInBlock;
     uint8_t* miniBlocksLoc = 0;
 
+    // Cartesian tree signatures of (up to) 64-element blocks (bit i refers to i-th element of a block):
+    // the left spine (prefix minima) and the right spine (suffix minima)
+    // (64-element blocks for CARTESIAN_BLOCKS, miniblocks for MINI_MASKS)
+    int ctKExp;
+    t_array_size ctBlocksCount;
+    uint64_t* ctPrefixMinMasks = 0;
+    uint64_t* ctSuffixMinMasks = 0;
+
     void getBlocksMinsBase();
+    void getCartesianSignatures(int ctKExp);
     void getBlocksSparseTable();
 
     t_array_size scanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& smallerThanVal, bool orEqual);
     inline t_array_size rawScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& smallerThanVal, bool orEqual);
     inline t_array_size miniScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& smallerThanVal, bool orEqual);
+    inline t_array_size ctScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& smallerThanVal, bool orEqual);
+    inline t_array_size ctBlockMinIdx(const t_array_size &begIdx, const t_array_size &endIdx);
+    inline t_array_size edgeScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value& smallerThanVal, bool orEqual);
+
+#ifdef RESULT_CACHE
+    RMQResultCache resultCache;
+    inline t_array_size uncachedRmq(const t_array_size &begIdx, const t_array_size &endIdx);
+#endif
 
     bool batchMode = false;
     void cleanup();
 
+    friend class BbSTCoroutines;
+
 };
 
 
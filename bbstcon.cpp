@@ -7,6 +7,9 @@
 #include <parallel/algorithm>
 #include "utils/kxsort.h"
 #include "utils/parallel_stable_sort.h"
+#include "utils/parallel_radix_sort.h"
+#include "utils/valuesfile.h"
+#include "utils/argmin.h"
 
 BbSTcon::BbSTcon(sortingAlg_enum sortingAlg, int kExp) {
     this->sortingAlg = sortingAlg;
@@ -14,13 +17,52 @@ BbSTcon::BbSTcon(sortingAlg_enum sortingAlg, int kExp) {
     this->k = 1 << kExp;
 }
 
+BbSTcon::~BbSTcon() {
+    release();
+}
+
 void BbSTcon::rmqBatch(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries, t_array_size *resultLoc) {
+    release();
     this->valuesArray = valuesArray;
     this->n = n;
     this->q = queries.size();
+    if (queries.empty())
+        return;
     getUniqueBoundsSorted(queries);
     getContractedMins();
     getBlocksMins();
+    getContractedResults(queries, resultLoc);
+    cleanup();
+/**/
+}
+
+bool BbSTcon::rmqBatchFromFile(const string &valuesFileName, const vector<t_array_size> &queries, t_array_size *resultLoc,
+        size_t chunkBytes, bool direct) {
+    release();
+    ValuesFileReader reader(valuesFileName, chunkBytes, direct);
+    if (!reader.isOpen())
+        return false;
+    this->valuesArray = 0;
+    this->n = reader.size();
+    this->q = queries.size();
+    streamedBytesCount = 0;
+    streamingSeconds = 0;
+    if (queries.empty())
+        return true;
+    getUniqueBoundsSorted(queries);
+    const bool streamed = getContractedMinsStreamed(reader);
+    streamedBytesCount = reader.readBytes;
+    streamingSeconds = reader.readSeconds;
+    streamingDirect = reader.isDirect();
+    if (streamed) {
+        getBlocksMins();
+        getContractedResults(queries, resultLoc);
+    }
+    cleanup();
+    return streamed;
+}
+
+void BbSTcon::getContractedResults(const vector<t_array_size> &queries, t_array_size *resultLoc) {
     #pragma omp parallel for
     for(int i = 0; i < queries.size(); i = i + 2) {
         if (queries[i] == queries[i+1]) {
@@ -29,8 +71,45 @@ void BbSTcon::rmqBatch(const t_value* valuesArray, const t_array_size n, const v
         }
         resultLoc[i/2] = getContractedRMQ(queries2ContractedIdx[i], queries2ContractedIdx[i + 1]);
     }
-    cleanup();
-/**/
+}
+
+void BbSTcon::prepare(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries) {
+    release();
+    this->valuesArray = valuesArray;
+    this->n = n;
+    this->q = queries.size();
+    if (queries.empty())
+        return;
+    getUniqueBoundsSorted(queries);
+    addGridBounds();
+    getContractedMins();
+    getBlocksMins();
+    getBoundsBuckets();
+    delete[] queries2ContractedIdx;
+    queries2ContractedIdx = 0;
+    prepared = true;
+}
+
+void BbSTcon::rmqBatchPrepared(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+    #pragma omp parallel for
+    for(int i = 0; i < queries.size(); i = i + 2) {
+        if (queries[i] == queries[i+1]) {
+            resultLoc[i/2] = queries[i];
+            continue;
+        }
+        resultLoc[i/2] = getPreparedRMQ(queries[i], queries[i + 1]);
+    }
+}
+
+void BbSTcon::release() {
+    if (prepared) {
+        cleanup();
+        prepared = false;
+    }
+}
+
+double BbSTcon::compressionRatio() {
+    return q ? (double) queriesUniqueBoundsCount / q : 0;
 }
 
 struct RadixTraitsBounds {
@@ -60,30 +139,155 @@ void BbSTcon::getUniqueBoundsSorted(const vector<t_array_size> &queries) {
             break;
         case ompparallelsort  : __gnu_parallel::sort(bounds, bounds + queries.size(), [](const t_array_size_2x& a, const t_array_size_2x& b) -> bool { return *((t_array_size*) &a) < *((t_array_size*) &b); }, __gnu_parallel::multiway_mergesort_tag());
             break;
+        case ompradixsort : prs::parallel_radix_sort<t_array_size_2x, t_array_size>(bounds, bounds + queries.size(), [](const t_array_size_2x& x) -> t_array_size { return *((t_array_size*) &x); });
+            break;
     }
+    uniqueBounds = new t_array_size[queries.size()];
     queries2ContractedIdx = new t_array_size[queries.size()];
+    uniqueBoundsCount = 0;
     for(t_array_size i = 0; i < queries.size(); i++) {
-        queries2ContractedIdx[*(((t_array_size*) &bounds[i]) + 1)] = i;
+        const t_array_size bound = *((t_array_size*) &bounds[i]);
+        if (uniqueBoundsCount == 0 || uniqueBounds[uniqueBoundsCount - 1] != bound)
+            uniqueBounds[uniqueBoundsCount++] = bound;
+        queries2ContractedIdx[*(((t_array_size*) &bounds[i]) + 1)] = uniqueBoundsCount - 1;
     }
+    contractedCount = uniqueBoundsCount - 1;
+    queriesUniqueBoundsCount = uniqueBoundsCount;
+    delete[] bounds;
+    bounds = 0;
+}
+
+// splits the gaps longer than 2^gridExp (also before the first and after the last bound) by the multiples of 2^gridExp
+// (and n-1), where 2^gridExp is the least power of 2 with (unique bounds) * 2^gridExp >= 2n, so at most half as many
+// bounds are added and the scans of getPreparedRMQ for endpoints which are not prepared bounds are shorter than
+// 2^gridExp < 4n / (unique bounds)
+void BbSTcon::addGridBounds() {
+    if (n == 0)
+        return;
+    int gridExp = 0;
+    while (((t_array_size_2x) max(uniqueBoundsCount, (t_array_size) 1) << gridExp) < 2 * (t_array_size_2x) n)
+        gridExp++;
+    const t_array_size_2x gridStep = (t_array_size_2x) 1 << gridExp;
+    vector<t_array_size> merged;
+    merged.reserve(uniqueBoundsCount + (n >> gridExp) + 2);
+    t_array_size_2x prev = -1;
+    for (t_array_size i = 0; i <= uniqueBoundsCount; i++) {
+        const t_array_size_2x next = i < uniqueBoundsCount ? uniqueBounds[i] : n - 1;
+        if (next - prev > gridStep)
+            for (t_array_size_2x pos = (prev + gridStep) & ~(gridStep - 1); pos < next; pos += gridStep)
+                merged.push_back(pos);
+        if (next > prev)
+            merged.push_back(next);
+        prev = next;
+    }
+    uniqueBoundsCount = merged.size();
+    contractedCount = uniqueBoundsCount - 1;
+    delete[] uniqueBounds;
+    uniqueBounds = new t_array_size[uniqueBoundsCount];
+    std::copy(merged.begin(), merged.end(), uniqueBounds);
 }
 
 void BbSTcon::getContractedMins() {
-    contractedVal = new t_value[q - 1];
-    contractedLoc = new t_array_size[q - 1];
+    contractedVal = new t_value[contractedCount + 1];
+    contractedLoc = new t_array_size[contractedCount + 1];
 
+    // minima of gaps [bound j, bound j+1) scanned over equal pieces of positions (one per thread) instead of
+    // distributing the gaps, so a long gap is split between threads; the partial minima of gaps cut by the borders
+    // of pieces (at most two per piece) are merged in the order of pieces
+    const t_array_size begIdx = uniqueBounds[0];
+    const t_array_size scanLength = uniqueBounds[contractedCount] - begIdx;
+    const int piecesCount = (int) min((t_array_size) omp_get_max_threads(), max(scanLength, (t_array_size) 1));
+    vector<t_array_size> partialGap(2 * piecesCount, MAX_T_ARRAYSIZE);
+    vector<t_value> partialVal(2 * piecesCount);
+    vector<t_array_size> partialLoc(2 * piecesCount);
+    #pragma omp parallel for schedule(static, 1)
+    for(int p = 0; p < piecesCount; p++) {
+        const t_array_size pieceBeg = begIdx + (t_array_size) ((t_array_size_2x) scanLength * p / piecesCount);
+        const t_array_size pieceEnd = begIdx + (t_array_size) ((t_array_size_2x) scanLength * (p + 1) / piecesCount);
+        t_array_size j = std::upper_bound(uniqueBounds, uniqueBounds + contractedCount, pieceBeg) - uniqueBounds - 1;
+        for(; j < contractedCount && uniqueBounds[j] < pieceEnd; j++) {
+            const t_array_size scanBeg = max(uniqueBounds[j], pieceBeg);
+            const t_array_size scanEnd = min(uniqueBounds[j + 1], pieceEnd);
+            const t_value *const minPtr = minElement(&valuesArray[scanBeg], &valuesArray[scanEnd]);
+            if (scanBeg == uniqueBounds[j] && scanEnd == uniqueBounds[j + 1]) {
+                contractedVal[j] = *minPtr;
+                contractedLoc[j] = minPtr - &valuesArray[0];
+            } else {
+                const int slot = 2 * p + (scanBeg == pieceBeg ? 0 : 1);
+                partialGap[slot] = j;
+                partialVal[slot] = *minPtr;
+                partialLoc[slot] = minPtr - &valuesArray[0];
+            }
+        }
+    }
+    t_array_size mergedGap = MAX_T_ARRAYSIZE;
+    for(int slot = 0; slot < 2 * piecesCount; slot++) {
+        const t_array_size j = partialGap[slot];
+        if (j == MAX_T_ARRAYSIZE)
+            continue;
+        if (j != mergedGap || partialVal[slot] < contractedVal[j]) {
+            contractedVal[j] = partialVal[slot];
+            contractedLoc[j] = partialLoc[slot];
+        }
+        mergedGap = j;
+    }
+    // contracted entry j covers [bound j, bound j+1]
     #pragma omp parallel for
-    for(int i = 1;  i < q; i++) {
-        t_array_size minIdx = *((t_array_size*) (bounds + i - 1));
-        const t_array_size endIdx = *((t_array_size*) (bounds + i));
-
-        const int *const minPtr = std::min_element(&valuesArray[minIdx], &valuesArray[endIdx + 1]);
-        contractedVal[i-1] = *minPtr;
-        contractedLoc[i-1] = minPtr - &valuesArray[0];
+    for(long long int j = 0; j < contractedCount; j++) {
+        const t_value boundVal = valuesArray[uniqueBounds[j + 1]];
+        if (boundVal < contractedVal[j]) {
+            contractedVal[j] = boundVal;
+            contractedLoc[j] = uniqueBounds[j + 1];
+        }
     }
+    // the last bound (getContractedRMQ reads the entry of the end contracted index)
+    contractedVal[contractedCount] = valuesArray[uniqueBounds[contractedCount]];
+    contractedLoc[contractedCount] = uniqueBounds[contractedCount];
+}
+
+// the same contracted minima as getContractedMins computed on the fly while the file is streamed:
+// the minimum of the gap [bound j, bound j+1) is scanned chunk by chunk and closed by the value at bound j+1
+bool BbSTcon::getContractedMinsStreamed(ValuesFileReader &reader) {
+    contractedVal = new t_value[contractedCount + 1];
+    contractedLoc = new t_array_size[contractedCount + 1];
+
+    t_array_size j = 0;     // the next bound
+    t_value gapMinVal = MAX_T_VALUE;
+    t_array_size gapMinLoc = 0;
+    const bool read = reader.stream(uniqueBounds[0], uniqueBounds[contractedCount] + 1,
+            [&](const t_value* chunk, const t_array_size chunkBegIdx, const t_array_size count) {
+        t_array_size i = 0;
+        while (i < count && j <= contractedCount) {
+            const t_array_size boundPos = min(uniqueBounds[j] - chunkBegIdx, count);
+            if (boundPos > i) {
+                const t_value *const minPtr = minElement(chunk + i, chunk + boundPos);
+                if (*minPtr < gapMinVal) {
+                    gapMinVal = *minPtr;
+                    gapMinLoc = chunkBegIdx + (minPtr - chunk);
+                }
+            }
+            if (boundPos == count)
+                break;
+            const t_value boundVal = chunk[boundPos];
+            if (j > 0) {
+                contractedVal[j - 1] = gapMinVal <= boundVal ? gapMinVal : boundVal;
+                contractedLoc[j - 1] = gapMinVal <= boundVal ? gapMinLoc : uniqueBounds[j];
+            }
+            if (j == contractedCount) {
+                contractedVal[j] = boundVal;
+                contractedLoc[j] = uniqueBounds[j];
+            }
+            gapMinVal = boundVal;
+            gapMinLoc = uniqueBounds[j];
+            j++;
+            i = boundPos + 1;
+        }
+    });
+    return read && j > contractedCount;
 }
 
 void BbSTcon::getBlocksMins() {
-    this->blocksCount = (q - 1 + k - 1) >> kExp;
+    this->blocksCount = max((contractedCount + k - 1) >> kExp, (t_array_size) 1);
     D = 32 - __builtin_clz(blocksCount);
     const t_array_size blocksSize = blocksCount * D;
     blocksVal2D = new t_value[blocksSize];
@@ -94,7 +298,7 @@ void BbSTcon::getBlocksMins() {
         blocksVal2D[i] = *minPtr;
         blocksLoc2D[i] = contractedLoc[minPtr - contractedVal];
     }
-    auto minPtr = std::min_element(&contractedVal[(blocksCount - 1) << kExp], &contractedVal[q - 1]);
+    auto minPtr = std::min_element(&contractedVal[(blocksCount - 1) << kExp], &contractedVal[contractedCount]);
     blocksVal2D[blocksCount - 1] = *minPtr;
     blocksLoc2D[blocksCount - 1] = contractedLoc[minPtr - contractedVal];
     for(t_array_size e = 1, step = 1; e < D; ++e, step <<= 1) {
@@ -163,6 +367,51 @@ t_array_size BbSTcon::getContractedRMQ(const t_array_size &begContIdx, const t_a
     return result;
 }
 
+void BbSTcon::getBoundsBuckets() {
+    bucketsExp = 0;
+    while (((t_array_size_2x) uniqueBoundsCount << (bucketsExp + 1)) <= n)
+        bucketsExp++;
+    const t_array_size bucketsCount = (n >> bucketsExp) + 2;
+    boundsBuckets = new t_array_size[bucketsCount];
+    t_array_size i = 0;
+    for (t_array_size b = 0; b < bucketsCount; b++) {
+        while (i < uniqueBoundsCount && (uniqueBounds[i] >> bucketsExp) < b)
+            i++;
+        boundsBuckets[b] = i;
+    }
+}
+
+// index of the first unique bound >= idx
+inline t_array_size BbSTcon::boundsLowerIdx(const t_array_size &idx) {
+    const t_array_size bucket = idx >> bucketsExp;
+    t_array_size i = boundsBuckets[bucket];
+    const t_array_size endI = boundsBuckets[bucket + 1];
+    while (i < endI && uniqueBounds[i] < idx)
+        i++;
+    return i;
+}
+
+t_array_size BbSTcon::getPreparedRMQ(const t_array_size &begIdx, const t_array_size &endIdx) {
+    // contracted range between the first bound >= begIdx and the last bound <= endIdx
+    const t_array_size begContIdx = boundsLowerIdx(begIdx);
+    const t_array_size boundsToEndCount = boundsLowerIdx(endIdx + 1);
+    if (begContIdx + 1 >= boundsToEndCount)
+        return minElement(&valuesArray[begIdx], &valuesArray[endIdx + 1]) - &valuesArray[0];
+    const t_array_size endContIdx = boundsToEndCount - 1;
+    t_array_size result = getContractedRMQ(begContIdx, endContIdx);
+    if (begIdx < uniqueBounds[begContIdx]) {
+        const t_value* minPtr = minElement(&valuesArray[begIdx], &valuesArray[uniqueBounds[begContIdx]]);
+        if (*minPtr <= valuesArray[result])
+            result = minPtr - &valuesArray[0];
+    }
+    if (uniqueBounds[endContIdx] < endIdx) {
+        const t_value* minPtr = minElement(&valuesArray[uniqueBounds[endContIdx] + 1], &valuesArray[endIdx + 1]);
+        if (*minPtr < valuesArray[result])
+            result = minPtr - &valuesArray[0];
+    }
+    return result;
+}
+
 t_array_size BbSTcon::scanContractedMinIdx(const t_array_size &begContIdx, const t_array_size &endContIdx) {
     t_array_size minValIdx = begContIdx;
     for(t_array_size i = begContIdx + 1; i < endContIdx; i++) {
@@ -175,21 +424,33 @@ t_array_size BbSTcon::scanContractedMinIdx(const t_array_size &begContIdx, const
 
 void BbSTcon::cleanup() {
     delete[] this->bounds;
+    this->bounds = 0;
+    delete[] this->uniqueBounds;
+    this->uniqueBounds = 0;
+    delete[] this->boundsBuckets;
+    this->boundsBuckets = 0;
     delete[] this->blocksLoc2D;
+    this->blocksLoc2D = 0;
     delete[] this->blocksVal2D;
+    this->blocksVal2D = 0;
     delete[] this->contractedLoc;
+    this->contractedLoc = 0;
     delete[] this->contractedVal;
+    this->contractedVal = 0;
     delete[] this->queries2ContractedIdx;
+    this->queries2ContractedIdx = 0;
 }
 
 size_t BbSTcon::memUsageInBytes() {
     const size_t boundsBytes = q * sizeof(t_array_size_2x);
     const size_t queries2ContractedIdxBytes = q * sizeof(t_array_size);
-    const size_t contractedBytes = (q - 1) * (sizeof(t_value) + sizeof(t_array_size));
-    const t_array_size blocksCount = ((q - 1 + k - 1)/ k);
+    const size_t uniqueBoundsBytes = (prepared ? uniqueBoundsCount : q) * sizeof(t_array_size);
+    const size_t contractedBytes = (contractedCount + 1) * (sizeof(t_value) + sizeof(t_array_size));
+    const t_array_size blocksCount = max((contractedCount + k - 1) / k, (t_array_size) 1);
     D = 32 - __builtin_clz(blocksCount);
     const t_array_size blocksSize = blocksCount * D;
     const size_t blocksBytes = blocksSize * (sizeof(t_value) + sizeof(t_array_size));
-    const size_t bytes = boundsBytes + queries2ContractedIdxBytes + contractedBytes + blocksBytes;
+    const size_t boundsBucketsBytes = prepared ? ((n >> bucketsExp) + 2) * sizeof(t_array_size) : 0;
+    const size_t bytes = boundsBytes + queries2ContractedIdxBytes + uniqueBoundsBytes + contractedBytes + blocksBytes + boundsBucketsBytes;
     return bytes;
 }
@@ -2,25 +2,52 @@
 #define BBSTCON_H
 
 #include <vector>
+#include <string>
 #include "common.h"
 
 using namespace std;
 
+class ValuesFileReader;
+
 enum sortingAlg_enum
 {
     csort = 'q',
     stdsort = 's',
     kxradixsort = 'r',
     ompparallelsort = 'p',
-    pssparallelsort = 'i'
+    pssparallelsort = 'i',
+    ompradixsort = 'l'
 };
 
 class BbSTcon {
 public:
     BbSTcon(sortingAlg_enum sortingAlg, int kExp);
 
+    virtual ~BbSTcon();
+
     void rmqBatch(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries, t_array_size *resultLoc);
 
+    // keeps the contracted structure of the bounds of queries alive (until release or the next prepare), so successive
+    // batches sharing most of the endpoints are answered by rmqBatchPrepared without sorting and contracting again
+    // (an endpoint which is not a bound of the prepared queries costs a scan of valuesArray up to the nearest bound;
+    // prepare adds a grid of at most as many bounds as the queries have, so a scan is shorter than 2n / unique bounds)
+    void prepare(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries);
+    void rmqBatchPrepared(const vector<t_array_size> &queries, t_array_size *resultLoc);
+    void release();
+
+    // answers the batch streaming the values from a binary file of t_value (n = file size / sizeof(t_value)) in chunks
+    // of chunkBytes (O_DIRECT if supported, see utils/valuesfile.h); the file is read once from the first to the last bound
+    // and the array is never kept in memory (O(q) memory plus the chunk buffer); returns false if the file cannot be read
+    bool rmqBatchFromFile(const string &valuesFileName, const vector<t_array_size> &queries, t_array_size *resultLoc,
+            size_t chunkBytes = 1 << 24, bool direct = true);
+    // bytes read, time spent in reads [s] and whether the file was read with O_DIRECT (by the last rmqBatchFromFile)
+    size_t streamedBytes() { return streamedBytesCount; }
+    double streamingTime() { return streamingSeconds; }
+    bool streamedDirect() { return streamingDirect; }
+
+    // unique bounds count / bounds count (of the last batch or prepared queries)
+    double compressionRatio();
+
     size_t memUsageInBytes();
 
 private:
@@ -37,17 +64,33 @@ private:
 
     t_array_size_2x* bounds = 0;
     t_array_size* queries2ContractedIdx = 0;
+    t_array_size* uniqueBounds = 0;
+    t_array_size uniqueBoundsCount, contractedCount;
+    t_array_size queriesUniqueBoundsCount;     // without the grid bounds of prepare
+    // index of the first unique bound in each bucket of 2^bucketsExp positions (of the prepared structure)
+    t_array_size* boundsBuckets = 0;
+    int bucketsExp;
     t_value* contractedVal = 0;
     t_array_size* contractedLoc = 0;
     t_value* blocksVal2D = 0;
     t_array_size*  blocksLoc2D = 0;
 
     void getUniqueBoundsSorted(const vector<t_array_size> &queries);
+    void addGridBounds();
     void getContractedMins();
+    bool getContractedMinsStreamed(ValuesFileReader &reader);
+    void getContractedResults(const vector<t_array_size> &queries, t_array_size *resultLoc);
     void getBlocksMins();
     t_array_size getContractedRMQ(const t_array_size &begContIdx, const t_array_size &endContIdx);
     t_array_size scanContractedMinIdx(const t_array_size &begContIdx, const t_array_size &endContIdx);
+    void getBoundsBuckets();
+    inline t_array_size boundsLowerIdx(const t_array_size &idx);
+    t_array_size getPreparedRMQ(const t_array_size &begIdx, const t_array_size &endIdx);
 
+    bool prepared = false;
+    size_t streamedBytesCount = 0;
+    double streamingSeconds = 0;
+    bool streamingDirect = false;
     void cleanup();
 };
 
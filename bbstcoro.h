@@ -0,0 +1,98 @@
+#ifndef BBSTCORO_H
+#define BBSTCORO_H
+
+// C++20 coroutine version of the interleaved BbST batch (requires -std=c++20, see the bbst_coro_nb target).
+// Each thread runs inFlight coroutines round robin; a coroutine answers every inFlight-th query of the thread and
+// suspends after prefetching the sparse table values and after prefetching the location of the minimum.
+
+#if __cplusplus < 202002L
+#error "bbstcoro.h requires C++20"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include "bbst.h"
+#include <omp.h>
+
+class BbSTCoroutines {
+private:
+    struct QueryTask {
+        struct promise_type {
+            QueryTask get_return_object() { return QueryTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+
+        explicit QueryTask(std::coroutine_handle<promise_type> handle): handle(handle) {}
+        QueryTask(QueryTask &&other) noexcept: handle(other.handle) { other.handle = nullptr; }
+        QueryTask(const QueryTask &) = delete;
+        ~QueryTask() { if (handle) handle.destroy(); }
+    };
+
+    static QueryTask answerQueries(BbST &solver, const vector<t_array_size> &queries, t_array_size *resultLoc,
+            t_array_size queryIdx, const t_array_size endQueryIdx, const int stride) {
+        for (; queryIdx < endQueryIdx; queryIdx += stride) {
+            const t_array_size begIdx = queries[2 * queryIdx];
+            const t_array_size endIdx = queries[2 * queryIdx + 1];
+            if (begIdx == endIdx) {
+                resultLoc[queryIdx] = begIdx;
+                continue;
+            }
+            const t_array_size begCompIdx = begIdx >> solver.kExp;
+            const t_array_size endCompIdx = endIdx >> solver.kExp;
+            const t_array_size kBlockCount = endCompIdx - begCompIdx;
+            const t_array_size e = kBlockCount?(31 - __builtin_clz(kBlockCount)):0;
+            const t_array_size endShiftCompIdx = endCompIdx - (1 << e) + 1;
+            const t_value* levelVal = solver.blocksVal2D + e * solver.blocksCount;
+            __builtin_prefetch(&levelVal[begCompIdx]);
+            __builtin_prefetch(&levelVal[endShiftCompIdx]);
+            co_await std::suspend_always();
+
+            const t_array_size locIdx = (levelVal[begCompIdx] <= levelVal[endShiftCompIdx] ? begCompIdx : endShiftCompIdx)
+                    + e * solver.blocksCount;
+            __builtin_prefetch(&solver.blocksLoc2D[locIdx]);
+            co_await std::suspend_always();
+
+            RMQ_STATS_QUERY_BEGIN();
+#ifndef WORST_CASE
+            const t_array_size result = solver.blocksLoc2D[locIdx];
+            if (begIdx <= result && result <= endIdx)
+                resultLoc[queryIdx] = result;
+            else
+#endif
+                resultLoc[queryIdx] = solver.rmq(begIdx, endIdx);
+            RMQ_STATS_QUERY_END();
+        }
+    }
+
+public:
+    static void rmqBatch(BbST &solver, const vector<t_array_size> &queries, t_array_size *resultLoc, int inFlight) {
+        const t_array_size q = queries.size() / 2;
+        #pragma omp parallel
+        {
+            const int threadsCount = omp_get_num_threads();
+            const int thread = omp_get_thread_num();
+            const t_array_size begQueryIdx = ((t_array_size_2x) q * thread) / threadsCount;
+            const t_array_size endQueryIdx = ((t_array_size_2x) q * (thread + 1)) / threadsCount;
+            vector<QueryTask> tasks;
+            tasks.reserve(inFlight);
+            for (int s = 0; s < inFlight; s++)
+                tasks.push_back(answerQueries(solver, queries, resultLoc, begQueryIdx + s, endQueryIdx, inFlight));
+            int active = inFlight;
+            while (active) {
+                for (QueryTask &task: tasks)
+                    if (!task.handle.done()) {
+                        task.handle.resume();
+                        if (task.handle.done())
+                            active--;
+                    }
+            }
+        }
+    }
+};
+
+#endif //BBSTCORO_H
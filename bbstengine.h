@@ -0,0 +1,246 @@
+#ifndef BBSTENGINE_H
+#define BBSTENGINE_H
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "common.h"
+
+#include <immintrin.h>
+#include <omp.h>
+
+using namespace std;
+
+// Asynchronous batch queries over a built RMQ structure (BbST, BbSTh, BbSTx, CBbSTx; any T with a thread-safe
+// rmqBatch(queries, resultLoc)) answered by a persistent pool of workers instead of an OpenMP parallel region per batch.
+// Submitted batches are split into chunks of at most chunkQueries queries and put into a bounded lock-free MPMC queue.
+// A worker coalesces chunks (possibly of different batches) until it has coalesceQueries queries or maxDelayMicros
+// passed since it took the first one, and answers them with a single rmqBatch call (with one OpenMP thread, the
+// workers are the parallelism). A batch completes (future/callback) when its last chunk is answered.
+// Queries and resultLoc have to stay valid until the batch completes.
+template<class T> class BbSTQueryEngine {
+private:
+    struct BatchRequest {
+        const vector<t_array_size>* queries;
+        t_array_size* resultLoc;
+        atomic<t_array_size> remainingChunks;
+        promise<void> done;
+        function<void()> callback;
+    };
+
+    struct QueryChunk {
+        BatchRequest* request;
+        t_array_size begQuery, endQuery;    // query indexes [begQuery, endQuery)
+    };
+
+    // bounded MPMC queue (D. Vyukov), cells carry sequence numbers so producers and consumers do not lock
+    struct alignas(64) QueueCell {
+        atomic<size_t> sequence;
+        QueryChunk chunk;
+    };
+
+    static const size_t QUEUE_CAPACITY = 1 << 16;
+    QueueCell* cells;
+    // padding (not alignas, the engine itself is allocated by new) keeps the positions in separate cache lines
+    char enqueuePad[64];
+    atomic<size_t> enqueuePos;
+    char dequeuePad[64];
+    atomic<size_t> dequeuePos;
+    char afterDequeuePad[64];
+
+    T &solver;
+    const t_array_size coalesceQueries;
+    const int maxDelayMicros;
+    const t_array_size chunkQueries;
+
+    vector<thread> workers;
+    atomic<bool> stopping;
+    atomic<int> sleepingWorkers;
+    mutex sleepMutex;
+    condition_variable wakeUp;
+
+    bool tryEnqueue(const QueryChunk &chunk) {
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        while (true) {
+            QueueCell &cell = cells[pos & (QUEUE_CAPACITY - 1)];
+            const size_t sequence = cell.sequence.load(memory_order_acquire);
+            const intptr_t dif = (intptr_t) sequence - (intptr_t) pos;
+            if (dif == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    cell.chunk = chunk;
+                    cell.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0)
+                return false;
+            else
+                pos = enqueuePos.load(memory_order_relaxed);
+        }
+    }
+
+    bool tryDequeue(QueryChunk &chunk) {
+        size_t pos = dequeuePos.load(memory_order_relaxed);
+        while (true) {
+            QueueCell &cell = cells[pos & (QUEUE_CAPACITY - 1)];
+            const size_t sequence = cell.sequence.load(memory_order_acquire);
+            const intptr_t dif = (intptr_t) sequence - (intptr_t) (pos + 1);
+            if (dif == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    chunk = cell.chunk;
+                    cell.sequence.store(pos + QUEUE_CAPACITY, memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0)
+                return false;
+            else
+                pos = dequeuePos.load(memory_order_relaxed);
+        }
+    }
+
+    bool isQueueEmpty() {
+        return dequeuePos.load(memory_order_acquire) >= enqueuePos.load(memory_order_acquire);
+    }
+
+    // a whole batch is passed to rmqBatch as is, otherwise the queries of the chunks are gathered and results scattered
+    void answerCoalesced(const vector<QueryChunk> &coalesced, vector<t_array_size> &coalescedQueries,
+            vector<t_array_size> &coalescedResults) {
+        const BatchRequest* first = coalesced[0].request;
+        if (coalesced.size() == 1 && coalesced[0].begQuery == 0 && 2 * coalesced[0].endQuery == first->queries->size())
+            solver.rmqBatch(*first->queries, first->resultLoc);
+        else {
+            coalescedQueries.clear();
+            for (const QueryChunk &chunk: coalesced)
+                coalescedQueries.insert(coalescedQueries.end(), chunk.request->queries->begin() + 2 * chunk.begQuery,
+                        chunk.request->queries->begin() + 2 * chunk.endQuery);
+            coalescedResults.resize(coalescedQueries.size() / 2);
+            solver.rmqBatch(coalescedQueries, coalescedResults.data());
+            const t_array_size* result = coalescedResults.data();
+            for (const QueryChunk &chunk: coalesced) {
+                copy(result, result + (chunk.endQuery - chunk.begQuery), chunk.request->resultLoc + chunk.begQuery);
+                result += chunk.endQuery - chunk.begQuery;
+            }
+        }
+        for (const QueryChunk &chunk: coalesced)
+            completeChunk(chunk.request);
+    }
+
+    void completeChunk(BatchRequest* request) {
+        if (request->remainingChunks.fetch_sub(1, memory_order_acq_rel) == 1) {
+            if (request->callback)
+                request->callback();
+            request->done.set_value();
+            delete request;
+        }
+    }
+
+    void workerLoop() {
+        omp_set_num_threads(1);
+        vector<QueryChunk> coalesced;
+        vector<t_array_size> coalescedQueries, coalescedResults;
+        int idleSpins = 0;
+        while (true) {
+            QueryChunk chunk;
+            if (!tryDequeue(chunk)) {
+                if (stopping.load(memory_order_acquire) && isQueueEmpty())
+                    return;
+                if (++idleSpins < 1024) {
+                    _mm_pause();
+                    continue;
+                }
+                unique_lock<mutex> lock(sleepMutex);
+                sleepingWorkers++;
+                wakeUp.wait_for(lock, chrono::milliseconds(1), [this] { return !isQueueEmpty() || stopping.load(); });
+                sleepingWorkers--;
+                continue;
+            }
+            idleSpins = 0;
+            coalesced.clear();
+            coalesced.push_back(chunk);
+            t_array_size queriesCount = chunk.endQuery - chunk.begQuery;
+            const chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::microseconds(maxDelayMicros);
+            while (queriesCount < coalesceQueries) {
+                if (tryDequeue(chunk)) {
+                    coalesced.push_back(chunk);
+                    queriesCount += chunk.endQuery - chunk.begQuery;
+                } else if (stopping.load(memory_order_relaxed) || chrono::steady_clock::now() >= deadline)
+                    break;
+                else
+                    _mm_pause();
+            }
+            answerCoalesced(coalesced, coalescedQueries, coalescedResults);
+        }
+    }
+
+    BatchRequest* newBatchRequest(const vector<t_array_size> &queries, t_array_size *resultLoc, function<void()> callback) {
+        BatchRequest* request = new BatchRequest();
+        request->queries = &queries;
+        request->resultLoc = resultLoc;
+        request->callback = callback;
+        return request;
+    }
+
+    void enqueueBatch(BatchRequest* request) {
+        const t_array_size queriesCount = request->queries->size() / 2;
+        const t_array_size chunksCount = queriesCount ? (queriesCount + chunkQueries - 1) / chunkQueries : 1;
+        request->remainingChunks.store(chunksCount, memory_order_relaxed);
+        for (t_array_size c = 0; c < chunksCount; c++) {
+            const QueryChunk chunk = { request, c * chunkQueries, min(queriesCount, (c + 1) * chunkQueries) };
+            while (!tryEnqueue(chunk))
+                this_thread::yield();
+        }
+        // under sleepMutex, a worker either sees the chunks before it waits or is already waiting for this notify
+        lock_guard<mutex> lock(sleepMutex);
+        if (sleepingWorkers.load(memory_order_relaxed) > 0)
+            wakeUp.notify_all();
+    }
+
+public:
+    BbSTQueryEngine(T &solver, int threadsCount, t_array_size coalesceQueries = 4096, int maxDelayMicros = 20,
+            t_array_size chunkQueries = 16384): solver(solver), coalesceQueries(coalesceQueries),
+            maxDelayMicros(maxDelayMicros), chunkQueries(chunkQueries) {
+        // new does not honour alignas(64) before C++17
+        void* cellsMemory;
+        if (posix_memalign(&cellsMemory, alignof(QueueCell), QUEUE_CAPACITY * sizeof(QueueCell)))
+            throw bad_alloc();
+        cells = (QueueCell*) cellsMemory;
+        for (size_t i = 0; i < QUEUE_CAPACITY; i++) {
+            new (cells + i) QueueCell();
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+        enqueuePos.store(0);
+        dequeuePos.store(0);
+        stopping.store(false);
+        sleepingWorkers.store(0);
+        for (int t = 0; t < threadsCount; t++)
+            workers.push_back(thread(&BbSTQueryEngine::workerLoop, this));
+    }
+
+    // answers all submitted batches before returning
+    virtual ~BbSTQueryEngine() {
+        stopping.store(true, memory_order_release);
+        wakeUp.notify_all();
+        for (thread &worker: workers)
+            worker.join();
+        for (size_t i = 0; i < QUEUE_CAPACITY; i++)
+            cells[i].~QueueCell();
+        free(cells);
+    }
+
+    future<void> submit(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+        BatchRequest* request = newBatchRequest(queries, resultLoc, nullptr);
+        future<void> result = request->done.get_future();
+        enqueueBatch(request);
+        return result;
+    }
+
+    // callback is called by a worker after the last query of the batch is answered
+    void submit(const vector<t_array_size> &queries, t_array_size *resultLoc, function<void()> callback) {
+        enqueueBatch(newBatchRequest(queries, resultLoc, callback));
+    }
+};
+
+#endif //BBSTENGINE_H
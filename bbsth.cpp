@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include "bbsth.h"
+#include <omp.h>
+
+BbSTh::BbSTh(const t_value* valuesArray, const t_array_size n, const vector<int> &levelsKExp) {
+    // offsets of minima in child levels are stored in 8 or 16 bits
+    if (levelsKExp.empty())
+        throw std::invalid_argument("BbSTh: no levels given");
+    for (size_t l = 0; l < levelsKExp.size(); l++) {
+        const int delKExp = levelsKExp[l] - (l ? levelsKExp[l - 1] : 0);
+        if (delKExp < 1 || (l < levelsKExp.size() - 1 && delKExp > 16))
+            throw std::invalid_argument("BbSTh: expected ascending levels with 16>=(k_l - k_l-1)>=1 (k_-1=0)");
+    }
+    this->valuesArray = valuesArray;
+    this->n = n;
+    this->kExp = levelsKExp.back();
+    this->k = 1 << kExp;
+    this->levelsCount = levelsKExp.size() - 1;
+    this->levels = new BbSThLevel[levelsCount];
+    for (int l = 0; l < levelsCount; l++) {
+        levels[l].kExp = levelsKExp[l];
+        levels[l].delKExp = levelsKExp[l] - (l ? levelsKExp[l - 1] : 0);
+    }
+    getLevelsMins();
+    getBlocksMinsBase();
+    getBlocksSparseTable();
+}
+
+BbSTh::~BbSTh() {
+    cleanup();
+}
+
+void BbSTh::rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+    #pragma omp parallel for
+    for (int i = 0; i < queries.size(); i = i + 2) {
+        resultLoc[i / 2] = rmq(queries[i], queries[i + 1]);
+    }
+}
+
+void BbSTh::getLevelsMins() {
+    for (int l = 0; l < levelsCount; l++) {
+        BbSThLevel &level = levels[l];
+        level.blocksCount = (n + (1 << level.kExp) - 1) >> level.kExp;
+        level.blocksVal = allocTable<t_value>(level.blocksCount);
+        if (level.delKExp > 8)
+            level.blocksLoc16 = allocTable<uint16_t>(level.blocksCount);
+        else
+            level.blocksLoc8 = allocTable<uint8_t>(level.blocksCount);
+        const t_value* childVal = l ? levels[l - 1].blocksVal : valuesArray;
+        const t_array_size childCount = l ? levels[l - 1].blocksCount : n;
+        const int delKExp = level.delKExp;
+        #pragma omp parallel for
+        for (t_array_size i = 0; i < level.blocksCount; i++) {
+            const t_array_size childEndIdx = std::min(childCount, (i + 1) << delKExp);
+            auto minPtr = std::min_element(&childVal[i << delKExp], &childVal[childEndIdx]);
+            level.blocksVal[i] = *minPtr;
+            if (level.blocksLoc16)
+                level.blocksLoc16[i] = minPtr - &childVal[i << delKExp];
+            else
+                level.blocksLoc8[i] = minPtr - &childVal[i << delKExp];
+        }
+    }
+}
+
+void BbSTh::getBlocksMinsBase() {
+    this->blocksCount = (n + k - 1) >> kExp;
+    this->D = 32 - __builtin_clz(blocksCount);
+    const t_array_size blocksSize = blocksCount * D;
+    blocksVal2D = allocTable<t_value>(blocksSize);
+    blocksLoc2D = allocTable<t_array_size>(blocksSize);
+
+    const int childLevel = levelsCount - 1;
+    const t_value* childVal = levelsCount ? levels[childLevel].blocksVal : valuesArray;
+    const t_array_size childCount = levelsCount ? levels[childLevel].blocksCount : n;
+    const int delKExp = kExp - (levelsCount ? levels[childLevel].kExp : 0);
+    #pragma omp parallel for
+    for (t_array_size i = 0; i < blocksCount; i++) {
+        const t_array_size childEndIdx = std::min(childCount, (i + 1) << delKExp);
+        auto minPtr = std::min_element(&childVal[i << delKExp], &childVal[childEndIdx]);
+        blocksVal2D[i] = *minPtr;
+        if (levelsCount)
+            blocksLoc2D[i] = blockMinLoc(childLevel, minPtr - childVal);
+        else
+            blocksLoc2D[i] = minPtr - childVal;
+    }
+}
+
+void BbSTh::getBlocksSparseTable() {
+    for(t_array_size e = 1, step = 1; e < D; ++e, step <<= 1) {
+        for (t_array_size i = 0; i < blocksCount; i++) {
+            t_array_size minIdx = i;
+            const t_array_size e0offset = (e - 1) * blocksCount;
+            if (i + step < blocksCount && blocksVal2D[(i + step) + e0offset] < blocksVal2D[i + e0offset]) {
+                minIdx = i + step;
+            }
+            const t_array_size e1offset = e * blocksCount;
+            blocksVal2D[i + e1offset] = blocksVal2D[minIdx + e0offset];
+            blocksLoc2D[i + e1offset] = blocksLoc2D[minIdx + e0offset];
+        }
+    }
+}
+
+inline t_array_size BbSTh::blockMinLoc(int level, t_array_size blockIdx) {
+    for(; level >= 0; level--) {
+        const BbSThLevel &lvl = levels[level];
+        blockIdx = (blockIdx << lvl.delKExp) + (lvl.blocksLoc16?lvl.blocksLoc16[blockIdx]:lvl.blocksLoc8[blockIdx]);
+    }
+    return blockIdx;
+}
+
+t_array_size BbSTh::rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+    if (begIdx == endIdx) {
+        return begIdx;
+    }
+    t_array_size result = MAX_T_ARRAYSIZE;
+    const t_array_size begCompIdx = begIdx >> kExp;
+    const t_array_size endCompIdx = endIdx >> kExp;
+    if (endCompIdx == begCompIdx) {
+        result = blocksLoc2D[begCompIdx];
+        if (begIdx <= result && result <= endIdx)
+            return result;
+        return levelScanMinIdx(levelsCount - 1, begIdx, endIdx);
+    }
+    const t_array_size kBlockCount = endCompIdx - begCompIdx; // actual kBlock count is +1
+    const t_array_size e = 31 - __builtin_clz(kBlockCount);
+    const t_array_size step = 1 << e;
+    const t_array_size endShiftCompIdx = endCompIdx - step + 1;
+    t_value leftMin = blocksVal2D[begCompIdx + e * blocksCount];
+    t_value rightMin = blocksVal2D[endShiftCompIdx + e * blocksCount];
+    bool minOnTheLeft = leftMin <= rightMin;
+    result = blocksLoc2D[(minOnTheLeft?begCompIdx:endShiftCompIdx) + e * blocksCount];
+    if (begIdx <= result && result <= endIdx)
+        return result;
+
+    t_value minVal = MAX_T_VALUE;
+    result = MAX_T_ARRAYSIZE;
+    if (kBlockCount > 1) {
+        const t_array_size innerE = 31 - __builtin_clz(kBlockCount - 1);
+        t_array_size inner2DIdx = begCompIdx + 1 + innerE * blocksCount;
+        const t_array_size inner2DEndShiftIdx = endCompIdx - (1 << innerE) + innerE * blocksCount;
+        if (blocksVal2D[inner2DEndShiftIdx] < blocksVal2D[inner2DIdx])
+            inner2DIdx = inner2DEndShiftIdx;
+        minVal = blocksVal2D[inner2DIdx];
+        result = blocksLoc2D[inner2DIdx];
+    }
+    if (blocksVal2D[begCompIdx] <= minVal) {
+        t_array_size tempLoc = blocksLoc2D[begCompIdx];
+        if (tempLoc < begIdx)
+            tempLoc = levelScanMinIdx(levelsCount - 1, begIdx, ((begCompIdx + 1) << kExp) - 1);
+        if (valuesArray[tempLoc] <= minVal) {
+            minVal = valuesArray[tempLoc];
+            result = tempLoc;
+        }
+    }
+    if (blocksVal2D[endCompIdx] < minVal) {
+        t_array_size tempLoc = blocksLoc2D[endCompIdx];
+        if (tempLoc <= endIdx)
+            return tempLoc;
+        tempLoc = levelScanMinIdx(levelsCount - 1, endCompIdx << kExp, endIdx);
+        if (valuesArray[tempLoc] < minVal)
+            return tempLoc;
+    }
+    return result;
+}
+
+t_array_size BbSTh::levelScanMinIdx(int level, const t_array_size &begIdx, const t_array_size &endIdx) {
+    if (level < 0)
+        return rawScanMinIdx(begIdx, endIdx);
+    const BbSThLevel &lvl = levels[level];
+    const t_array_size begBlockIdx = begIdx >> lvl.kExp;
+    const t_array_size endBlockIdx = endIdx >> lvl.kExp;
+    if (begBlockIdx == endBlockIdx) {
+        const t_array_size minLoc = blockMinLoc(level, begBlockIdx);
+        if (begIdx <= minLoc && minLoc <= endIdx)
+            return minLoc;
+        return levelScanMinIdx(level - 1, begIdx, endIdx);
+    }
+    t_value minVal = MAX_T_VALUE;
+    t_array_size minBlockIdx = MAX_T_ARRAYSIZE;
+    for(t_array_size i = begBlockIdx + 1; i < endBlockIdx; i++) {
+        if (lvl.blocksVal[i] < minVal) {
+            minVal = lvl.blocksVal[i];
+            minBlockIdx = i;
+        }
+    }
+    t_array_size result = minBlockIdx == MAX_T_ARRAYSIZE?MAX_T_ARRAYSIZE:blockMinLoc(level, minBlockIdx);
+    if (lvl.blocksVal[begBlockIdx] <= minVal) {
+        t_array_size tempLoc = blockMinLoc(level, begBlockIdx);
+        if (tempLoc < begIdx)
+            tempLoc = levelScanMinIdx(level - 1, begIdx, ((begBlockIdx + 1) << lvl.kExp) - 1);
+        if (valuesArray[tempLoc] <= minVal) {
+            minVal = valuesArray[tempLoc];
+            result = tempLoc;
+        }
+    }
+    if (lvl.blocksVal[endBlockIdx] < minVal) {
+        t_array_size tempLoc = blockMinLoc(level, endBlockIdx);
+        if (tempLoc <= endIdx)
+            return tempLoc;
+        tempLoc = levelScanMinIdx(level - 1, endBlockIdx << lvl.kExp, endIdx);
+        if (valuesArray[tempLoc] < minVal)
+            return tempLoc;
+    }
+    return result;
+}
+
+inline t_array_size BbSTh::rawScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx) {
+    t_array_size minValIdx = begIdx;
+    for(t_array_size i = begIdx + 1; i <= endIdx; i++) {
+        if (valuesArray[i] < valuesArray[minValIdx]) {
+            minValIdx = i;
+        }
+    }
+    return minValIdx;
+}
+
+void BbSTh::cleanup() {
+    freeTable(this->blocksLoc2D);
+    freeTable(this->blocksVal2D);
+    for (int l = 0; l < levelsCount; l++) {
+        freeTable(levels[l].blocksVal);
+        freeTable(levels[l].blocksLoc8);
+        freeTable(levels[l].blocksLoc16);
+    }
+    delete[] this->levels;
+}
+
+size_t BbSTh::memUsageInBytes() {
+    const t_array_size blocksSize = blocksCount * D;
+    size_t bytes = blocksSize * (sizeof(t_value) + sizeof(t_array_size));
+    for (int l = 0; l < levelsCount; l++) {
+        bytes += (size_t) levels[l].blocksCount * (sizeof(t_value) + (levels[l].blocksLoc16?sizeof(uint16_t):sizeof(uint8_t)));
+    }
+    return bytes;
+}
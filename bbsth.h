@@ -0,0 +1,59 @@
+#ifndef BBST_BBSTH_H
+#define BBST_BBSTH_H
+
+#include <vector>
+#include "common.h"
+#include "utils/tablealloc.h"
+
+using namespace std;
+
+// Hierarchical BbST: the sparse table is built only over the top level superblocks,
+// each lower level stores blocks minima and narrow offsets of minima in the child level.
+class BbSTh {
+public:
+    // levelsKExp - ascending block size power of 2 exponents (the last one is the superblock size);
+    // throws std::invalid_argument unless 16>=(k_l - k_l-1)>=1 for all levels below superblocks (k_-1=0)
+    BbSTh(const t_value* valuesArray, const t_array_size n, const vector<int> &levelsKExp);
+
+    void rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc);
+    t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx);
+
+    virtual ~BbSTh();
+
+    size_t memUsageInBytes();
+
+private:
+    typedef struct {
+        int kExp;                   // block size exponent
+        int delKExp;                // child level block size exponent difference (kExp for level 0)
+        t_array_size blocksCount;
+        t_value* blocksVal = 0;
+        uint8_t* blocksLoc8 = 0;    // offset of minimum in child level (used if delKExp <= 8)
+        uint16_t* blocksLoc16 = 0;  // offset of minimum in child level (used if delKExp > 8)
+    } BbSThLevel;
+
+    t_array_size blocksCount;
+    int k, kExp, D;
+
+    const t_value *valuesArray;
+    t_array_size n;
+
+    int levelsCount = 0;             // number of levels below superblocks
+    BbSThLevel* levels = 0;
+
+    t_value* blocksVal2D = 0;
+    t_array_size*  blocksLoc2D = 0;
+
+    void getLevelsMins();
+    void getBlocksMinsBase();
+    void getBlocksSparseTable();
+
+    inline t_array_size blockMinLoc(int level, t_array_size blockIdx);
+    t_array_size levelScanMinIdx(int level, const t_array_size &begIdx, const t_array_size &endIdx);
+    inline t_array_size rawScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx);
+
+    void cleanup();
+
+};
+
+#endif //BBST_BBSTH_H
@@ -1,20 +1,44 @@
 #ifndef BBST_BBSTX_H
 #define BBST_BBSTX_H
 
+#include <atomic>
 #include <vector>
 #include "common.h"
 #include "hybtempl.h"
+#include "utils/fallbacks.h"
+#include "utils/rmqstats.h"
+#include "utils/tablealloc.h"
 
 using namespace std;
 
+class ValuesFileReader;
+
+// The secondary structure is called through Secondary: RMQAPI (the default, virtual calls) or a final
+// implementation (e.g. RMM64RMQ, SdslBPFastRMQ), whose queries are then called directly and can be inlined.
+template<class Secondary = RMQAPI>
 class BbSTx {
 public:
 
 #ifdef MINI_BLOCKS
-    BbSTx(const vector<t_value> &valuesArray, int kExp, int miniKExp, RMQAPI* secondaryRMQ);
+    BbSTx(const vector<t_value> &valuesArray, int kExp, int miniKExp, Secondary* secondaryRMQ);
+#else
+    BbSTx(const vector<t_value> &valuesArray, int kExp, Secondary* secondaryRMQ);
+#endif
+    // Streaming build: the values are read once from the file (see ValuesFileReader) and passed to the secondary
+    // structure as they come, so neither the values array nor its copy is kept in memory.
+    // StreamedSecondary provides appendValues and finishBuild (e.g. StreamedRMQAPI).
+    // RMQRMM64 spills its build stack (up to n values for increasing or nearly sorted values) to a temporary file
+    // beyond 2M values (n=5e7: peak RSS 81 MB for increasing vs 80 MB for random values).
+#ifdef MINI_BLOCKS
+    template<class StreamedSecondary>
+    BbSTx(ValuesFileReader &valuesFile, int kExp, int miniKExp, StreamedSecondary* secondaryRMQ);
 #else
-    BbSTx(const vector<t_value> &valuesArray, int kExp, RMQAPI* secondaryRMQ);
+    template<class StreamedSecondary>
+    BbSTx(ValuesFileReader &valuesFile, int kExp, StreamedSecondary* secondaryRMQ);
 #endif
+    // false if the streaming build failed to read the values file
+    bool isBuilt() { return built; }
+
     void rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc);
 
     t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx);
@@ -23,8 +47,19 @@ public:
 
     size_t memUsageInBytes();
 
+    // number of secondary structure queries of the last rmqBatch and the time of answering them [s]
+    size_t fallbacksCount() { return lastFallbacksCount; }
+    double fallbacksTime() { return lastFallbacksSeconds; }
+
 private:
-    RMQAPI* secondaryRMQ;
+#ifdef RMQ_STATS
+    RMQAPI* secondaryRMQ; // RMQStatsProbe of the given one
+#else
+    Secondary* secondaryRMQ;
+#endif
+    atomic<size_t> lastFallbacksCount{0};
+    atomic<double> lastFallbacksSeconds{0};
+    bool built = true;
 
     t_array_size blocksCount;
     int k, kExp, D, miniK, miniKExp;
@@ -40,13 +75,26 @@ private:
     uint8_t* miniBlocksLoc = 0;
     t_value* miniBlocksVal = 0;
 
+    void allocBlocks(const t_array_size n);
     void getBlocksMinsBase(const vector<t_value> &valuesArray);
+    template<class StreamedSecondary>
+    void getBlocksMinsStreamed(ValuesFileReader &valuesFile, StreamedSecondary* secondaryRMQ);
+#ifdef MINI_BLOCKS
+    void getBlocksMinsFromMiniBlocks();
+#endif
     void getBlocksSparseTable();
 
+    // the secondary structure queries go to sink (DirectFallback or DeferredFallbacks of a batch)
+    template<class Sink>
+    inline t_array_size rmqOrDefer(const t_array_size &begIdx, const t_array_size &endIdx, Sink &sink);
+    template<class Sink>
+    t_array_size narrowedFallbackRMQ(const t_array_size &begIdx, const t_array_size &endIdx, const t_array_size &begCompIdx, const t_array_size &endCompIdx, Sink &sink);
     inline t_array_size miniScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value &notSmallerThan);
 
     void cleanup();
 
 };
 
+#include "bbstx.hpp"
+
 #endif //BBST_BBSTX_H
@@ -3,45 +3,90 @@
 #include <numeric>
 
 #include "bbstx.h"
+#include "utils/blockmins.h"
+#include "utils/valuesfile.h"
 
 #include <omp.h>
 
-BbSTx::~BbSTx() {
+template<class Secondary> BbSTx<Secondary>::~BbSTx() {
     cleanup();
 }
 
 #ifdef MINI_BLOCKS
-BbSTx::BbSTx(const vector<t_value> &valuesArray, int kExp, int miniKExp, RMQAPI* secondaryRMQ) {
+template<class Secondary> BbSTx<Secondary>::BbSTx(const vector<t_value> &valuesArray, int kExp, int miniKExp, Secondary* secondaryRMQ) {
     this->miniKExp = miniKExp;
     this->miniK = 1 << miniKExp;
 #else
-BbSTx::BbSTx(const vector<t_value> &valuesArray, int kExp, RMQAPI* secondaryRMQ) {
+template<class Secondary> BbSTx<Secondary>::BbSTx(const vector<t_value> &valuesArray, int kExp, Secondary* secondaryRMQ) {
 #endif
     this->kExp = kExp;
     this->k = 1 << kExp;
+#ifdef RMQ_STATS
+    this->secondaryRMQ = new RMQStatsProbe(secondaryRMQ);
+#else
     this->secondaryRMQ = secondaryRMQ;
+#endif
     getBlocksMinsBase(valuesArray);
     getBlocksSparseTable();
 }
 
-void BbSTx::rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+#ifdef MINI_BLOCKS
+template<class Secondary> template<class StreamedSecondary> BbSTx<Secondary>::BbSTx(ValuesFileReader &valuesFile, int kExp, int miniKExp, StreamedSecondary* secondaryRMQ) {
+    this->miniKExp = miniKExp;
+    this->miniK = 1 << miniKExp;
+#else
+template<class Secondary> template<class StreamedSecondary> BbSTx<Secondary>::BbSTx(ValuesFileReader &valuesFile, int kExp, StreamedSecondary* secondaryRMQ) {
+#endif
+    this->kExp = kExp;
+    this->k = 1 << kExp;
+#ifdef RMQ_STATS
+    this->secondaryRMQ = new RMQStatsProbe(secondaryRMQ);
+#else
+    this->secondaryRMQ = secondaryRMQ;
+#endif
+    getBlocksMinsStreamed(valuesFile, secondaryRMQ);
+    getBlocksSparseTable();
+}
+
+// Secondary structure queries are deferred and answered together at the end, sorted by position
+// (with RMQ_STATS they are answered in place, to be included in the statistics of queries).
+template<class Secondary> void BbSTx<Secondary>::rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+#ifdef RMQ_STATS
     for (int i = 0; i < queries.size(); i = i + 2) {
+        RMQ_STATS_QUERY_BEGIN();
         resultLoc[i / 2] = rmq(queries[i], queries[i + 1]);
+        RMQ_STATS_QUERY_END();
+    }
+#else
+    DeferredFallbacks fallbacks;
+    for (int i = 0; i < queries.size(); i = i + 2) {
+        const t_array_size result = rmqOrDefer(queries[i], queries[i + 1], fallbacks);
+        resultLoc[i / 2] = result;
+        if (result == MAX_T_ARRAYSIZE)
+            fallbacks.add(i / 2);
     }
+    fallbacks.finishBatch(secondaryRMQ, resultLoc);
+    lastFallbacksCount = fallbacks.count;
+    lastFallbacksSeconds = fallbacks.seconds;
+#endif
 }
 
-void BbSTx::getBlocksMinsBase(const vector<t_value> &valuesArray) {
+template<class Secondary> void BbSTx<Secondary>::allocBlocks(const t_array_size n) {
 #ifdef MINI_BLOCKS
-    this->miniBlocksCount = (valuesArray.size() + miniK - 1) >> miniKExp;
-    this->miniBlocksLoc = new uint8_t[miniBlocksCount];
-    this->miniBlocksVal = new t_value[miniBlocksCount];
+    this->miniBlocksCount = (n + miniK - 1) >> miniKExp;
+    this->miniBlocksLoc = allocTable<uint8_t>(miniBlocksCount);
+    this->miniBlocksVal = allocTable<t_value>(miniBlocksCount);
     this->miniBlocksInBlock = k / miniK;
 #endif
-    this->blocksCount = (valuesArray.size() + k - 1) >> kExp;
+    this->blocksCount = (n + k - 1) >> kExp;
     this->D = 32 - __builtin_clz(blocksCount);
     const t_array_size blocksSize = blocksCount * D;
-    blocksVal2D = new t_value[blocksSize];
-    blocksLoc2D = new t_array_size[blocksSize];
+    blocksVal2D = allocTable<t_value>(blocksSize);
+    blocksLoc2D = allocTable<t_array_size>(blocksSize);
+}
+
+template<class Secondary> void BbSTx<Secondary>::getBlocksMinsBase(const vector<t_value> &valuesArray) {
+    allocBlocks(valuesArray.size());
 #ifdef MINI_BLOCKS
     #pragma omp parallel for
     for (t_array_size miniI = 0; miniI < this->miniBlocksCount - 1; miniI++) {
@@ -49,14 +94,11 @@ void BbSTx::getBlocksMinsBase(const vector<t_value> &valuesArray) {
         miniBlocksVal[miniI] = *miniMinPtr;
         miniBlocksLoc[miniI] = miniMinPtr - &valuesArray[miniI << miniKExp];
     }
-    int delKExp = kExp - miniKExp;
-    #pragma omp parallel for
-    for (t_array_size i = 0; i < blocksCount - 1; i++) {
-        auto minPtr = std::min_element(&miniBlocksVal[i << delKExp], &miniBlocksVal[(i + 1) << delKExp]);
-        blocksVal2D[i] = *minPtr;
-        t_array_size miniI = minPtr - &miniBlocksVal[0];
-        blocksLoc2D[i] = (miniI << miniKExp) + miniBlocksLoc[miniI];
-    }
+    const t_array_size miniI = this->miniBlocksCount - 1;
+    auto miniMinPtr = std::min_element(&valuesArray[miniI << miniKExp], &(*valuesArray.end()));
+    miniBlocksLoc[miniI] = miniMinPtr - &valuesArray[miniI << miniKExp];
+    miniBlocksVal[miniI] = *miniMinPtr;
+    getBlocksMinsFromMiniBlocks();
 #else
     #pragma omp parallel for
     for (t_array_size i = 0; i < blocksCount - 1; i++) {
@@ -64,29 +106,52 @@ void BbSTx::getBlocksMinsBase(const vector<t_value> &valuesArray) {
         blocksVal2D[i] = *minPtr;
         blocksLoc2D[i] = minPtr - &valuesArray[0];
     }
+    auto minPtr = std::min_element(&valuesArray[(blocksCount - 1) << kExp], &(*valuesArray.end()));
+    blocksVal2D[blocksCount - 1] = *minPtr;
+    blocksLoc2D[blocksCount - 1] = minPtr - &valuesArray[0];
 #endif
+}
+
 #ifdef MINI_BLOCKS
-    t_array_size miniI = (blocksCount - 1) << (kExp - miniKExp);
-    for (; miniI < this->miniBlocksCount - 1; miniI++) {
-        auto miniMinPtr = std::min_element(&valuesArray[miniI << miniKExp], &valuesArray[(miniI + 1) << miniKExp]);
-        miniBlocksLoc[miniI] = miniMinPtr - &valuesArray[miniI << miniKExp];
-        miniBlocksVal[miniI] = *miniMinPtr;
+template<class Secondary> void BbSTx<Secondary>::getBlocksMinsFromMiniBlocks() {
+    const int delKExp = kExp - miniKExp;
+    #pragma omp parallel for
+    for (t_array_size i = 0; i < blocksCount; i++) {
+        const t_array_size endMiniI = i < blocksCount - 1 ? (i + 1) << delKExp : miniBlocksCount;
+        auto minPtr = std::min_element(&miniBlocksVal[i << delKExp], &miniBlocksVal[0] + endMiniI);
+        blocksVal2D[i] = *minPtr;
+        const t_array_size miniI = minPtr - &miniBlocksVal[0];
+        blocksLoc2D[i] = (miniI << miniKExp) + miniBlocksLoc[miniI];
     }
-    auto miniMinPtr = std::min_element(&valuesArray[miniI << miniKExp], &(*valuesArray.end()));
-    miniBlocksLoc[miniI] = miniMinPtr - &valuesArray[miniI << miniKExp];
-    miniBlocksVal[miniI] = *miniMinPtr;
-    auto minPtr = std::min_element(&miniBlocksVal[blocksCount - 1 << delKExp], &miniBlocksVal[miniBlocksCount]);
-    blocksVal2D[blocksCount - 1] = *minPtr;
-    miniI = minPtr - &miniBlocksVal[0];
-    blocksLoc2D[blocksCount - 1] = (miniI << miniKExp) + miniBlocksLoc[miniI];
+}
+#endif
+
+// block (mini-block) minima are merged chunk by chunk, as are the values of the secondary structure
+template<class Secondary> template<class StreamedSecondary> void BbSTx<Secondary>::getBlocksMinsStreamed(ValuesFileReader &valuesFile, StreamedSecondary* secondaryRMQ) {
+    const t_array_size n = valuesFile.size();
+    if (!valuesFile.isOpen() || n == 0) {
+        built = false;
+        blocksCount = miniBlocksCount = D = 0;
+        return;
+    }
+    allocBlocks(n);
+    built = valuesFile.stream(0, n, [&](const t_value* values, t_array_size begIdx, t_array_size count) {
+#ifdef MINI_BLOCKS
+        appendBlocksMins(values, begIdx, count, miniKExp, miniBlocksVal, miniBlocksLoc, true);
 #else
-    auto minPtr = std::min_element(&valuesArray[(blocksCount - 1) << kExp], &(*valuesArray.end()));
-    blocksVal2D[blocksCount - 1] = *minPtr;
-    blocksLoc2D[blocksCount - 1] = minPtr - &valuesArray[0];
+        appendBlocksMins(values, begIdx, count, kExp, blocksVal2D, blocksLoc2D, false);
+#endif
+        secondaryRMQ->appendValues(values, count);
+    });
+    if (!built)
+        return;
+    secondaryRMQ->finishBuild();
+#ifdef MINI_BLOCKS
+    getBlocksMinsFromMiniBlocks();
 #endif
 }
 
-void BbSTx::getBlocksSparseTable() {
+template<class Secondary> void BbSTx<Secondary>::getBlocksSparseTable() {
     for(t_array_size e = 1, step = 1; e < D; ++e, step <<= 1) {
         for (t_array_size i = 0; i < blocksCount; i++) {
             t_array_size minIdx = i;
@@ -101,7 +166,12 @@ void BbSTx::getBlocksSparseTable() {
     }
 }
 
-t_array_size BbSTx::rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+template<class Secondary> t_array_size BbSTx<Secondary>::rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+    DirectFallback direct;
+    return rmqOrDefer(begIdx, endIdx, direct);
+}
+
+template<class Secondary> template<class Sink> inline t_array_size BbSTx<Secondary>::rmqOrDefer(const t_array_size &begIdx, const t_array_size &endIdx, Sink &sink) {
     if (begIdx == endIdx) {
         return begIdx;
     }
@@ -114,12 +184,12 @@ t_array_size BbSTx::rmq(const t_array_size &begIdx, const t_array_size &endIdx)
         if (begIdx <= result && result <= endIdx)
             return result;
 #ifndef MINI_BLOCKS
-        return secondaryRMQ->rmq(begIdx, endIdx);
+        return sink.query(secondaryRMQ, begIdx, endIdx);
 #else
         t_value miniNotSmallerThen = MAX_T_VALUE;
         t_array_size minIdx = miniScanMinIdx(begIdx, endIdx, miniNotSmallerThen);
         if (minIdx == MAX_T_ARRAYSIZE) {
-            return secondaryRMQ->rmq(begIdx, endIdx);
+            return sink.query(secondaryRMQ, begIdx, endIdx);
         }
         return minIdx;
 #endif
@@ -136,13 +206,17 @@ t_array_size BbSTx::rmq(const t_array_size &begIdx, const t_array_size &endIdx)
     if (begIdx <= result && result <= endIdx)
         return result;
 #ifndef MINI_BLOCKS
-    return secondaryRMQ->rmq(begIdx, endIdx);
+#ifdef NARROW_FALLBACK
+    return narrowedFallbackRMQ(begIdx, endIdx, begCompIdx, endCompIdx, sink);
+#else
+    return sink.query(secondaryRMQ, begIdx, endIdx);
+#endif
 #else
     t_value miniNotSmallerThen = MAX_T_VALUE;
     if (kBlockCount <= 1) {
         const t_array_size minIdx = miniScanMinIdx(begIdx, endIdx, miniNotSmallerThen);
         if (minIdx == MAX_T_ARRAYSIZE)
-            return secondaryRMQ->rmq(begIdx, endIdx);
+            return sink.query(secondaryRMQ, begIdx, endIdx);
         return minIdx;
     }
     bool uncertainMini = false;
@@ -184,7 +258,7 @@ t_array_size BbSTx::rmq(const t_array_size &begIdx, const t_array_size &endIdx)
             const t_array_size minIdx = miniScanMinIdx(endCompIdx << kExp, endIdx, miniNotSmallerThen);
             if (minIdx == MAX_T_ARRAYSIZE) {
                 if (miniNotSmallerThen < minVal)
-                    return secondaryRMQ->rmq(begIdx, endIdx);
+                    return sink.query(secondaryRMQ, begIdx, endIdx);
             } else if (miniBlocksVal[minIdx >> miniKExp] < minVal) {
                 return minIdx;
             }
@@ -192,14 +266,64 @@ t_array_size BbSTx::rmq(const t_array_size &begIdx, const t_array_size &endIdx)
     }
 
     if (uncertainMini)
-        return secondaryRMQ->rmq(begIdx, endIdx);
+        return sink.query(secondaryRMQ, begIdx, endIdx);
 
     return result;
 
 #endif
 }
 
-inline t_array_size BbSTx::miniScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value &notSmallerThan) {
+#ifdef NARROW_FALLBACK
+// Resolves the inner blocks and the edge blocks whose minima lie inside [begIdx, endIdx] from the sparse table
+// and asks the secondary structure only about the range spanning uncertain edges and the best known minimum.
+template<class Secondary> template<class Sink> t_array_size BbSTx<Secondary>::narrowedFallbackRMQ(const t_array_size &begIdx, const t_array_size &endIdx, const t_array_size &begCompIdx, const t_array_size &endCompIdx, Sink &sink) {
+    if (begCompIdx == endCompIdx)
+        return sink.query(secondaryRMQ, begIdx, endIdx);
+    t_value minVal = MAX_T_VALUE;
+    t_array_size result = MAX_T_ARRAYSIZE;
+    const t_array_size kBlockCount = endCompIdx - begCompIdx;
+    if (kBlockCount > 1) {
+        const t_array_size innerE = 31 - __builtin_clz(kBlockCount - 1);
+        t_array_size inner2DIdx = begCompIdx + 1 + innerE * blocksCount;
+        const t_array_size inner2DEndShiftIdx = endCompIdx - (1 << innerE) + innerE * blocksCount;
+        if (blocksVal2D[inner2DEndShiftIdx] < blocksVal2D[inner2DIdx])
+            inner2DIdx = inner2DEndShiftIdx;
+        minVal = blocksVal2D[inner2DIdx];
+        result = blocksLoc2D[inner2DIdx];
+    }
+    const t_value leftVal = blocksVal2D[begCompIdx];
+    const t_array_size leftLoc = blocksLoc2D[begCompIdx];
+    bool uncertainLeft = false;
+    if (leftVal <= minVal) {
+        if (leftLoc >= begIdx) {
+            minVal = leftVal;
+            result = leftLoc;
+        } else
+            uncertainLeft = true;
+    }
+    const t_value rightVal = blocksVal2D[endCompIdx];
+    const t_array_size rightLoc = blocksLoc2D[endCompIdx];
+    bool uncertainRight = false;
+    if (rightVal < minVal || result == MAX_T_ARRAYSIZE) {
+        if (rightLoc <= endIdx) {
+            minVal = rightVal;
+            result = rightLoc;
+            uncertainLeft = uncertainLeft && leftVal <= minVal;
+        } else
+            uncertainRight = true;
+    }
+    if (uncertainLeft && uncertainRight)
+        return sink.query(secondaryRMQ, begIdx, endIdx);
+    if (uncertainLeft)
+        return sink.query(secondaryRMQ, begIdx, result);
+    if (uncertainRight)
+        return sink.query(secondaryRMQ, result, endIdx);
+    return result;
+}
+#endif
+
+template<class Secondary> inline t_array_size BbSTx<Secondary>::miniScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_value &notSmallerThan) {
+    RMQ_STATS_PATH(miniPath);
     t_array_size result = MAX_T_ARRAYSIZE;
     const t_array_size begMiniIdx = begIdx >> miniKExp;
     const t_array_size endMiniIdx = endIdx >> miniKExp;
@@ -249,16 +373,19 @@ inline t_array_size BbSTx::miniScanMinIdx(const t_array_size &begIdx, const t_ar
     return result;
 }
 
-void BbSTx::cleanup() {
-    delete[] this->blocksLoc2D;
-    delete[] this->blocksVal2D;
+template<class Secondary> void BbSTx<Secondary>::cleanup() {
+    freeTable(this->blocksLoc2D);
+    freeTable(this->blocksVal2D);
 #ifdef MINI_BLOCKS
-    delete[] this->miniBlocksLoc;
-    delete[] this->miniBlocksVal;
+    freeTable(this->miniBlocksLoc);
+    freeTable(this->miniBlocksVal);
+#endif
+#ifdef RMQ_STATS
+    delete this->secondaryRMQ;
 #endif
 }
 
-size_t BbSTx::memUsageInBytes() {
+template<class Secondary> size_t BbSTx<Secondary>::memUsageInBytes() {
     const t_array_size blocksSize = blocksCount * D;
     size_t bytes = blocksSize * (sizeof(t_value) + sizeof(t_array_size));
 #ifdef MINI_BLOCKS
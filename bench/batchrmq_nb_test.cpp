@@ -0,0 +1,105 @@
+#include <iostream>
+#include <algorithm>
+
+#include "../utils/testdata.h"
+#include "../utils/timer.h"
+#include "../utils/benchargs.h"
+#include "../batchrmq.h"
+
+#include <unistd.h>
+#include <omp.h>
+
+int main(int argc, char**argv) {
+
+    BenchResults results("BatchRMQ_res.txt");
+
+    ChronoStopWatch timer;
+    BenchArgs args(argc, argv, "ktmw", "c:Cs:b:");
+    args.kExp = 12;
+    args.minKExp = 1;
+    bool calibration = false;
+    string configFile = "batchrmq.cfg";
+    sortingAlg_enum sortingAlg = kxradixsort;
+    int batches = 1;
+    int opt; // current option
+
+    while ((opt = args.nextOption()) != -1) {
+        switch (opt) {
+            case 'c':
+                configFile = optarg;
+                break;
+            case 'C':
+                calibration = true;
+                break;
+            case 's':
+                sortingAlg = (sortingAlg_enum) optarg[0];
+                if (sortingAlg != csort && sortingAlg != ompparallelsort && sortingAlg != pssparallelsort &&
+                        sortingAlg != stdsort && sortingAlg != kxradixsort && sortingAlg != ompradixsort)
+                    args.fail("Unknown sorting algorithm option.");
+                break;
+            case 'b':
+                batches = atoi(optarg);
+                if (batches <= 0)
+                    args.fail("Expected number of batches >=1");
+                break;
+            default: /* '?' */
+                args.usage("[-c cost model file] [-C] [-s sortingAlgorithm] [-b batches] ",
+                        "-c cost model config file (default batchrmq.cfg)\n-C calibrate the cost model (with -s sorting, -k block size and -t threads) and save it to the config file\n"
+                        "-s [q-quicksort;s-stdsort;r-kxradixsort;i-psspparallelsort;p-ompparallelsort;l-ompradixsort] BbSTcon sorting (calibration only)\n"
+                        "-b [batches>=1] repeated batches over the same array\n");
+        }
+    }
+
+    args.parseSizes();
+    t_array_size n = args.n;
+    t_array_size q = args.q;
+
+    omp_set_num_threads(args.noOfThreads);
+    BatchRMQCostModel model;
+    if (calibration) {
+        if (args.verbose) cout << "Calibration of the cost model..." << std::endl;
+        model = BatchRMQ::calibrate(sortingAlg, args.kExp);
+        model.save(configFile);
+    } else if (!model.load(configFile))
+        fprintf(stderr, "%s: Cannot read cost model %s (run with -C to calibrate), using defaults\n", argv[0], configFile.c_str());
+    if (model.threads != args.noOfThreads)
+        fprintf(stderr, "%s: Cost model calibrated for %d threads (running %d)\n", argv[0], model.threads, args.noOfThreads);
+    if (model.bbstKExp != args.kExp)
+        fprintf(stderr, "%s: Cost model calibrated for k=%d (running k=%d)\n", argv[0], 1 << model.bbstKExp, 1 << args.kExp);
+
+    if (args.verbose) cout << "Generation of values..." << std::endl;
+    vector<t_value> valuesArray(n);
+#ifdef RANDOM_DATA
+    getRandomValues(valuesArray, MAX_T_VALUE / 4);
+#else
+    getPermutationOfRange(valuesArray);
+#endif
+
+    if (args.verbose) cout << "Generation of queries..." << std::endl;
+    vector<pair<t_array_size, t_array_size>> queriesPairs(q);
+    getWorkloadRangeQueries(args.workload, queriesPairs, valuesArray, args.max_range, 1 << args.kExp);
+    vector<t_array_size> queries = flattenQueries(queriesPairs, q);
+    t_array_size* resultLoc = new t_array_size[queries.size() / 2];
+
+    BatchRMQ solver(model, args.kExp);
+    if (args.verbose) cout << "Solving... " << std::endl;
+    if (args.verbose) cout << "elapsed time [s]; batch; engine; n; q; m; size [KB]; k; sorting; noOfThreads; estimated BbST (with build)/BbST/BbSTcon time [s]" << std::endl;
+    for(int b = 0; b < batches; b++) {
+        const double bbstBuildEstimate = solver.bbstCost(n, q, true) / 1e9;
+        const double bbstEstimate = solver.bbstCost(n, q, false) / 1e9;
+        const double bbstconEstimate = solver.bbstconCost(n, q) / 1e9;
+        cleanCache();
+        timer.startTimer();
+        solver.rmqBatch(&valuesArray[0], valuesArray.size(), queries, resultLoc);
+        timer.stopTimer();
+        ostringstream resultLine;
+        resultLine << timer.getElapsedTime() << "\t" << b << "\t" << (char) solver.lastEngine() << "\t" << valuesArray.size() << "\t" << q << "\t" << args.max_range
+             << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << args.kExp) << "\t" << (char) model.sortingAlg << "\t" << args.noOfThreads
+             << "\t" << bbstBuildEstimate << "\t" << bbstEstimate << "\t" << bbstconEstimate << "\t";
+        results.emit(resultLine);
+        if (args.verification) verify(valuesArray, queries, resultLoc);
+    }
+
+    if (args.verbose) cout << "The end..." << std::endl;
+    return 0;
+}
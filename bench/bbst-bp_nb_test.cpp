@@ -3,7 +3,10 @@
 
 #include "../utils/testdata.h"
 #include "../utils/timer.h"
-#include "../includes/RMQRMM64.h"
+#include "../utils/benchargs.h"
+#include "../utils/perfcounters.h"
+#include "../rmm64rmq.h"
+#include "../utils/valuesfile.h"
 #ifdef QUANTIZED
 #include "../cbbstx.h"
 #else
@@ -12,161 +15,184 @@
 #include <unistd.h>
 #include <omp.h>
 
-class CompetitorRMQ: public RMQAPI {
-private:
-    RMQRMM64 *rmqImpl;
-public:
-
-    CompetitorRMQ(const t_value* valuesArray, const t_array_size n) {
-        rmqImpl = new RMQRMM64((t_value*) valuesArray, n);
-    }
-
-    ~CompetitorRMQ() {
-        delete rmqImpl;
-    }
-
-    t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
-        return rmqImpl->queryRMQ(begIdx, endIdx);
-    }
-
-    size_t memUsageInBytes() {
-        return rmqImpl->getSize();
-    }
-};
+typedef RMM64RMQ CompetitorRMQ;
 
+#ifdef NARROW_FALLBACK
+string rmqName = "BbST-BP-nf";
+#elif defined(RMM_WORD_OPS)
+string rmqName = "BbST-BP-wo";
+#else
 string rmqName = "BbST-BP";
+#endif
 
-int main(int argc, char**argv) {
-
-#ifdef QUANTIZED
-    rmqName = string("c") + rmqName;
-    fstream fout(rmqName + "_nb_res.txt", ios::out | ios::binary | ios::app);
+// the hybrid calls the secondary structure through RMQAPI (virtual calls) with VIRTUAL_SECONDARY
+#ifdef VIRTUAL_SECONDARY
+typedef RMQAPI SecondaryRMQ;
 #else
-    fstream fout(rmqName + "_nb_res.txt", ios::out | ios::binary | ios::app);
+typedef CompetitorRMQ SecondaryRMQ;
 #endif
+
+int main(int argc, char**argv) {
+
     ChronoStopWatch timer;
-    bool verbose = true;
-    bool verification = false;
-    int kExp = 14;
-    int noOfThreads = 1;
+    BenchArgs args(argc, argv, "ktrmwpa", "iF:D");
     int opt; // current option
-    int repeats = 1;
-    t_array_size max_range = 0;
+    bool inPlace = false;
+    string valuesFile;
+    bool directIO = true;
 
-    while ((opt = getopt(argc, argv, "k:t:r:m:vq?")) != -1) {
+    while ((opt = args.nextOption()) != -1) {
         switch (opt) {
-            case 'q':
-                verbose = false;
-                break;
-            case 'v':
-                verification = true;
-                break;
-            case 'k':
-                kExp = atoi(optarg);
-                if (kExp < 0 || kExp > 24) {
-                    fprintf(stderr, "%s: Expected 24>=k>=0\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case 't':
-                noOfThreads = atoi(optarg);
-                if (noOfThreads <= 0) {
-                    fprintf(stderr, "%s: Expected noOfThreads >=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+            case 'i':
+                inPlace = true;
                 break;
-            case 'r':
-                repeats = atoi(optarg);
-                if (repeats <= 0) {
-                    fprintf(stderr, "%s: Expected number of repeats >=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+            case 'F':
+                valuesFile = optarg;
                 break;
-            case 'm':
-                max_range = atoi(optarg);
-                if (max_range <= 0) {
-                    fprintf(stderr, "%s: Expected maximum size of a range>=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+            case 'D':
+                directIO = false;
                 break;
-            case '?':
             default: /* '?' */
-                fprintf(stderr, "Usage: %s [-k block size power of 2 exponent] [-t noOfThreads] [-v] [-q] n q\n\n",
-                        argv[0]);
-                fprintf(stderr, "-k [24>=k>=0] \n-t [noOfThreads>=1] \n-v verify results (extremely slow)\n-q quiet output (only parameters)\n\n");
-                exit(EXIT_FAILURE);
+                args.usage("[-i] [-F values file] [-D] ",
+                        "-i answer queries one by one (secondary queries in place, not deferred)\n"
+                        "-F streaming build from a binary file of n values (written with random values if it does not exist, otherwise it has to hold n values)\n"
+                        "-D read the values file through the page cache (default: O_DIRECT)\n");
         }
     }
 
-    if (optind > (argc - 2)) {
-        fprintf(stderr, "%s: Expected 2 arguments after options (found %d)\n", argv[0], argc-optind);
-        fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
+    args.parseSizes();
+    t_array_size n = args.n;
+    t_array_size q = args.q;
 
-        exit(EXIT_FAILURE);
-    }
-
-    t_array_size n = atoi(argv[optind++]);
-    t_array_size q = atoi(argv[optind]);
-    if (max_range == 0) {
-        max_range = n;
-    }
-
-    if (verbose) cout << "Generation of values..." << std::endl;
-    vector<t_value> valuesArray(n);
+#ifdef QUANTIZED
+    rmqName = string("c") + rmqName;
+#endif
+#ifdef VIRTUAL_SECONDARY
+    rmqName += "-virt";
+#endif
+    if (!valuesFile.empty())
+        rmqName += "-file";
+    if (inPlace)
+        rmqName += "-inplace";
+    BenchResults results(rmqName + "_nb_res.txt");
+
+    vector<t_value> valuesArray;
+    if (valuesFile.empty()) {
+        if (args.verbose) cout << "Generation of values..." << std::endl;
+        valuesArray.resize(n);
 #ifdef RANDOM_DATA
-    getRandomValues(valuesArray, MAX_T_VALUE / 4);
+        getRandomValues(valuesArray, MAX_T_VALUE / 4);
 #else
-    getPermutationOfRange(valuesArray);
+        getPermutationOfRange(valuesArray);
 #endif
+    } else {
+        // an existing file is never overwritten
+        if (access(valuesFile.c_str(), F_OK) != 0) {
+            if (args.verbose) cout << "Writing values file..." << std::endl;
+            writeRandomValuesFile(valuesFile, n, MAX_T_VALUE / 4);
+        }
+        fstream fin(valuesFile, ios::in | ios::binary | ios::ate);
+        if (!fin || (size_t) fin.tellg() != (size_t) n * sizeof(t_value)) {
+            fprintf(stderr, "%s: Values file %s cannot be read or its size is not n * %d bytes\n", argv[0], valuesFile.c_str(), (int) sizeof(t_value));
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    if (verbose) cout << "Generation of queries..." << std::endl;
+    if (args.verbose) cout << "Generation of queries..." << std::endl;
     vector<pair<t_array_size, t_array_size>> queriesPairs(q);
 
-    getRandomRangeQueries(queriesPairs, n, max_range);
+    if (valuesFile.empty())
+        getWorkloadRangeQueries(args.workload, queriesPairs, valuesArray, args.max_range, 1 << args.kExp);
+    else
+        getWorkloadRangeQueries(args.workload, queriesPairs, n, args.max_range);
 
     vector<t_array_size> queries = flattenQueries(queriesPairs, q);
     t_array_size* resultLoc = new t_array_size[queries.size() / 2];
 
-    omp_set_num_threads(noOfThreads);
-    if (verbose) cout << "Building "<< rmqName << "... " << std::endl;
+    PerfCounters buildCounters(args.perfCounters), queryCounters(args.perfCounters);
+
+    omp_set_num_threads(args.noOfThreads);
+    if (args.verbose) cout << "Building "<< rmqName << "... " << std::endl;
+    buildCounters.startCounters();
     timer.startTimer();
-    CompetitorRMQ rmqIdx(&valuesArray[0], valuesArray.size());
 #ifdef QUANTIZED
-    CBbSTx<uint8_t, 255> solver(valuesArray, kExp, &rmqIdx);
+    typedef CBbSTx<uint8_t, 255, SecondaryRMQ> Solver;
 #else
-    BbSTx solver(valuesArray, kExp, &rmqIdx);
+    typedef BbSTx<SecondaryRMQ> Solver;
 #endif
+    CompetitorRMQ* rmqIdx;
+    Solver* solver;
+    ValuesFileReader* reader = 0;
+    if (valuesFile.empty()) {
+        rmqIdx = new CompetitorRMQ(&valuesArray[0], n);
+        solver = new Solver(valuesArray, args.kExp, rmqIdx);
+    } else {
+        reader = new ValuesFileReader(valuesFile, 1 << 24, directIO);
+        rmqIdx = new CompetitorRMQ(n);
+        solver = new Solver(*reader, args.kExp, rmqIdx);
+        if (!solver->isBuilt()) {
+            fprintf(stderr, "%s: Cannot read values file %s\n", argv[0], valuesFile.c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
 
     timer.stopTimer();
+    buildCounters.stopCounters();
     double buildTime = timer.getElapsedTime();
-    if (verbose) cout << "Solving... " << std::endl;
+    size_t buildPeakRSS = peakRSSInKB();
+    string fileResult;
+    if (reader) {
+        fileResult = to_string(reader->readBytes / 1e6) + "\t" + to_string(reader->readSeconds) + "\t" + (reader->isDirect() ? "1" : "0") + "\t";
+        delete reader;
+    }
+    if (args.verbose) cout << "Solving... " << std::endl;
 
     vector<double> times;
-    for(int i = 0; i < repeats; i++) {
+    for(int i = 0; i < args.repeats; i++) {
         cleanCache();
+#ifdef RMQ_STATS
+        RMQStats::instance().reset();
+#endif
+        queryCounters.startCounters();
         timer.startTimer();
-        solver.rmqBatch(queries, resultLoc);
+        if (inPlace) {
+            for (t_array_size j = 0; j < q; j++)
+                resultLoc[j] = solver->rmq(queries[2 * j], queries[2 * j + 1]);
+        } else
+            solver->rmqBatch(queries, resultLoc);
         timer.stopTimer();
+        queryCounters.stopCounters();
         times.push_back(timer.getElapsedTime());
     }
     std::sort(times.begin(), times.end());
     double nanoqcoef = 1000000000.0 / q;
-    double maxQueryTime = times[repeats - 1] * nanoqcoef ;
+    double maxQueryTime = times[args.repeats - 1] * nanoqcoef ;
     double medianQueryTime = times[times.size()/2] * nanoqcoef;
     double minQueryTime = times[0] * nanoqcoef;
-    if (verbose) cout << "query time [ns]; n; q; m; size [KB]; k; noOfThreads; BbST build time [s]; max/min time [ns]" << std::endl;
-    cout << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << max_range
-         << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << kExp) << "\t" << noOfThreads
-         << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << std::endl;
-    fout << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << max_range <<
-         "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << kExp) << "\t" << noOfThreads <<
-         "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << std::endl;
-    if (verification) verify(valuesArray, queries, resultLoc);
-
-    if (verbose) cout << "The end..." << std::endl;
+    double fallbackFraction = (double) solver->fallbacksCount() / q;
+    double fallbackTime = solver->fallbacksCount() ? solver->fallbacksTime() * 1e9 / solver->fallbacksCount() : 0;
+    if (args.verbose) cout << "query time [ns]; n; q; m; size [KB]; k; noOfThreads; BbST build time [s]; max/min time [ns]; peak RSS after build [KB]; secondary queries fraction; time per secondary query [ns]" << std::endl;
+    if (args.verbose && args.perfCounters) cout << "+ build " PERF_COUNTERS_HEADER " per element; query " PERF_COUNTERS_HEADER " per query" << std::endl;
+    if (args.verbose && !valuesFile.empty()) cout << "+ read [MB]; read time [s]; O_DIRECT" << std::endl;
+    ostringstream resultLine;
+    resultLine << medianQueryTime << "\t" << n << "\t" << (queries.size() / 2) << "\t" << args.max_range
+         << "\t" << (solver->memUsageInBytes() / 1000) << "\t" << (1 << args.kExp) << "\t" << args.noOfThreads
+         << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << buildPeakRSS << "\t" << fallbackFraction << "\t" << fallbackTime << "\t" << args.perfColumns(buildCounters, n, queryCounters, queries.size() / 2.0) << fileResult;
+    results.emit(resultLine);
+#ifdef RMQ_STATS
+    {
+        RMQStats::instance().dumpJSON(rmqName + "_nb_stats.json", rmqName, {{"n", (double) n}, {"q", (double) q}, {"m", (double) args.max_range},
+                {"k", (double) (1 << args.kExp)}, {"threads", (double) args.noOfThreads}});
+    }
+#endif
+    if (args.verification) {
+        if (!valuesFile.empty())
+            readValuesFile(valuesArray, valuesFile);
+        verify(valuesArray, queries, resultLoc);
+    }
+    delete solver;
+    delete rmqIdx;
+
+    if (args.verbose) cout << "The end..." << std::endl;
     return 0;
 }
\ No newline at end of file
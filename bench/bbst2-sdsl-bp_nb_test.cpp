@@ -3,7 +3,9 @@
 
 #include "../utils/testdata.h"
 #include "../utils/timer.h"
-#include "../includes/sdsl/rmq_succinct_bp_fast.hpp"
+#include "../utils/benchargs.h"
+#include "../utils/perfcounters.h"
+#include "../sdslrmq.h"
 #ifdef QUANTIZED
 #include "../cbbstx.h"
 #else
@@ -12,131 +14,50 @@
 #include <unistd.h>
 #include <omp.h>
 
-class CompetitorRMQ: public RMQAPI {
-private:
-    typedef sdsl::rmq_succinct_bp_fast<> rmqStruct;
-    rmqStruct *rmqImpl;
-public:
-
-    CompetitorRMQ(const t_value* valuesArray, const t_array_size n) {
-        typedef sdsl::int_vector<32> int_vector;
-        int_vector intVector(n);
-        for (t_array_size i = 0; i < n; i++) {
-            intVector[i] = (uint32_t)((int64_t) valuesArray[i]) - INT32_MIN;
-        }
-        rmqImpl = new rmqStruct(&intVector);
-    }
-
-    ~CompetitorRMQ() {
-        delete rmqImpl;
-    }
-
-    t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
-        return rmqImpl->operator()(begIdx, endIdx);
-    }
-
-    size_t memUsageInBytes() {
-        return sdsl::size_in_bytes(*rmqImpl);
-    }
-};
-
+#ifdef SDSL_SCT
+typedef SdslSctRMQ CompetitorRMQ;
+string rmqName = "BbST2-sdsl-SCT";
+#elif defined(SDSL_SADA)
+typedef SdslSadaRMQ CompetitorRMQ;
+string rmqName = "BbST2-sdsl-SADA";
+#elif defined(SDSL_BP_PLAIN)
+typedef SdslBPRMQ CompetitorRMQ;
+string rmqName = "BbST2-sdsl-BP-plain";
+#else
+typedef SdslBPFastRMQ CompetitorRMQ;
 string rmqName = "BbST2-sdsl-BP";
+#endif
+
+// the hybrid calls the secondary structure through RMQAPI (virtual calls) with VIRTUAL_SECONDARY
+#ifdef VIRTUAL_SECONDARY
+typedef RMQAPI SecondaryRMQ;
+#else
+typedef CompetitorRMQ SecondaryRMQ;
+#endif
 
 int main(int argc, char**argv) {
 
+#ifdef VIRTUAL_SECONDARY
+    rmqName += "-virt";
+#endif
 #ifdef QUANTIZED
     rmqName = string("c") + rmqName;
-    fstream fout(rmqName + "_nb_res.txt", ios::out | ios::binary | ios::app);
+    BenchResults results(rmqName + "_nb_res.txt");
 #else
-    fstream fout(rmqName + "_nb_res.txt", ios::out | ios::binary | ios::app);
+    BenchResults results(rmqName + "_nb_res.txt");
 #endif
     ChronoStopWatch timer;
-    bool verbose = true;
-    bool verification = false;
-    int kExp = 14;
-    int miniKExp = 7;
-    int noOfThreads = 1;
-    int opt; // current option
-    int repeats = 1;
-    t_array_size max_range = 0;
-
-    while ((opt = getopt(argc, argv, "k:l:t:r:m:vq?")) != -1) {
-        switch (opt) {
-            case 'q':
-                verbose = false;
-                break;
-            case 'v':
-                verification = true;
-                break;
-            case 'k':
-                kExp = atoi(optarg);
-                if (kExp < 1 || kExp > 24) {
-                    fprintf(stderr, "%s: Expected 24>=k>=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case 'l':
-                miniKExp = atoi(optarg);
-                if (miniKExp < 0 || miniKExp > 8) {
-                    fprintf(stderr, "%s: Expected 8>=l>=0\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case 't':
-                noOfThreads = atoi(optarg);
-                if (noOfThreads <= 0) {
-                    fprintf(stderr, "%s: Expected noOfThreads >=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case 'r':
-                repeats = atoi(optarg);
-                if (repeats <= 0) {
-                    fprintf(stderr, "%s: Expected number of repeats >=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case 'm':
-                max_range = atoi(optarg);
-                if (max_range <= 0) {
-                    fprintf(stderr, "%s: Expected maximum size of a range>=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case '?':
-            default: /* '?' */
-                fprintf(stderr, "Usage: %s [-k block size power of 2 exponent] [-l miniblock size power of 2 exponent] [-t noOfThreads] [-v] [-q] n q\n\n",
-                        argv[0]);
-                fprintf(stderr, "-k [24>=k>=1] \n-l [8>=l>=0] \n-t [noOfThreads>=1] \n-v verify results (extremely slow)\n-q quiet output (only parameters)\n\n");
-                exit(EXIT_FAILURE);
-        }
-    }
-
-    if (optind > (argc - 2)) {
-        fprintf(stderr, "%s: Expected 2 arguments after options (found %d)\n", argv[0], argc-optind);
-        fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-
-        exit(EXIT_FAILURE);
-    }
-
-    if (kExp <= miniKExp) {
-        fprintf(stderr, "%s: k block size must be greater then miniblock size (k=%d, l=%d) \n", argv[0], kExp, miniKExp);
+    BenchArgs args(argc, argv, "kltrmwpa", "");
+    args.minKExp = 1;
 
-        exit(EXIT_FAILURE);
-    }
+    while (args.nextOption() != -1)
+        args.usage("", "");
 
-    t_array_size n = atoi(argv[optind++]);
-    t_array_size q = atoi(argv[optind]);
-    if (max_range == 0) {
-        max_range = n;
-    }
+    args.parseSizes();
+    t_array_size n = args.n;
+    t_array_size q = args.q;
 
-    if (verbose) cout << "Generation of values..." << std::endl;
+    if (args.verbose) cout << "Generation of values..." << std::endl;
     vector<t_value> valuesArray(n);
 #ifdef RANDOM_DATA
     getRandomValues(valuesArray, MAX_T_VALUE / 4);
@@ -144,49 +65,58 @@ int main(int argc, char**argv) {
     getPermutationOfRange(valuesArray);
 #endif
 
-    if (verbose) cout << "Generation of queries..." << std::endl;
+    if (args.verbose) cout << "Generation of queries..." << std::endl;
     vector<pair<t_array_size, t_array_size>> queriesPairs(q);
 
-    getRandomRangeQueries(queriesPairs, n, max_range);
+    getWorkloadRangeQueries(args.workload, queriesPairs, valuesArray, args.max_range, 1 << args.kExp);
 
     vector<t_array_size> queries = flattenQueries(queriesPairs, q);
     t_array_size* resultLoc = new t_array_size[queries.size() / 2];
 
-    omp_set_num_threads(noOfThreads);
-    if (verbose) cout << "Building "<< rmqName << "... " << std::endl;
+    PerfCounters buildCounters(args.perfCounters), queryCounters(args.perfCounters);
+
+    omp_set_num_threads(args.noOfThreads);
+    if (args.verbose) cout << "Building "<< rmqName << "... " << std::endl;
+    buildCounters.startCounters();
     timer.startTimer();
     CompetitorRMQ rmqIdx(&valuesArray[0], valuesArray.size());
 #ifdef QUANTIZED
-    CBbSTx<uint8_t, 255> solver(valuesArray, kExp, miniKExp, &rmqIdx);
+    CBbSTx<uint8_t, 255, SecondaryRMQ> solver(valuesArray, args.kExp, args.miniKExp, &rmqIdx);
 #else
-    BbSTx solver(valuesArray, kExp, miniKExp, &rmqIdx);
+    BbSTx<SecondaryRMQ> solver(valuesArray, args.kExp, args.miniKExp, &rmqIdx);
 #endif
     timer.stopTimer();
+    buildCounters.stopCounters();
     double buildTime = timer.getElapsedTime();
-    if (verbose) cout << "Solving... " << std::endl;
+    size_t buildPeakRSS = peakRSSInKB();
+    if (args.verbose) cout << "Solving... " << std::endl;
 
     vector<double> times;
-    for(int i = 0; i < repeats; i++) {
+    for(int i = 0; i < args.repeats; i++) {
         cleanCache();
+        queryCounters.startCounters();
         timer.startTimer();
         solver.rmqBatch(queries, resultLoc);
         timer.stopTimer();
+        queryCounters.stopCounters();
         times.push_back(timer.getElapsedTime());
     }
     std::sort(times.begin(), times.end());
     double nanoqcoef = 1000000000.0 / q;
-    double maxQueryTime = times[repeats - 1] * nanoqcoef ;
+    double maxQueryTime = times[args.repeats - 1] * nanoqcoef ;
     double medianQueryTime = times[times.size()/2] * nanoqcoef;
     double minQueryTime = times[0] * nanoqcoef;
-    if (verbose) cout << "query time [ns]; n; q; m; size [KB]; k; miniK; noOfThreads; BbST build time [s]; max/min time [ns]" << std::endl;
-    cout << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << max_range
-         << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << kExp) << "\t" << (1 << miniKExp) << "\t" << noOfThreads
-         << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << std::endl;
-    fout << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << max_range <<
-         "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << kExp) << "\t" << (1 << miniKExp) << "\t" << noOfThreads <<
-         "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << std::endl;
-    if (verification) verify(valuesArray, queries, resultLoc);
-
-    if (verbose) cout << "The end..." << std::endl;
+    double fallbackFraction = (double) solver.fallbacksCount() / q;
+    double fallbackTime = solver.fallbacksCount() ? solver.fallbacksTime() * 1e9 / solver.fallbacksCount() : 0;
+    if (args.verbose) cout << "query time [ns]; n; q; m; size [KB]; k; miniK; noOfThreads; BbST build time [s]; max/min time [ns]; peak RSS after build [KB]; secondary queries fraction; time per secondary query [ns]" << std::endl;
+    if (args.verbose && args.perfCounters) cout << "+ build " PERF_COUNTERS_HEADER " per element; query " PERF_COUNTERS_HEADER " per query" << std::endl;
+    ostringstream resultLine;
+    resultLine << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << args.max_range
+         << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << args.kExp) << "\t" << (1 << args.miniKExp) << "\t" << args.noOfThreads
+         << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << buildPeakRSS << "\t" << fallbackFraction << "\t" << fallbackTime << "\t" << args.perfColumns(buildCounters, valuesArray.size(), queryCounters, queries.size() / 2.0);
+    results.emit(resultLine);
+    if (args.verification) verify(valuesArray, queries, resultLoc);
+
+    if (args.verbose) cout << "The end..." << std::endl;
     return 0;
 }
\ No newline at end of file
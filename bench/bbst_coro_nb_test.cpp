@@ -0,0 +1,126 @@
+#include <iostream>
+#include <algorithm>
+
+#include "../utils/testdata.h"
+#include "../utils/timer.h"
+#include "../utils/benchargs.h"
+#include "../bbstcoro.h"
+
+#include <unistd.h>
+#include <omp.h>
+
+vector<int> parseInFlightCounts(const char* countsStr) {
+    vector<int> counts;
+    stringstream countsStream(countsStr);
+    string countStr;
+    while (getline(countsStream, countStr, ','))
+        counts.push_back(atoi(countStr.c_str()));
+    return counts;
+}
+
+int main(int argc, char**argv) {
+
+#ifdef MINI_BLOCKS
+    BenchResults results("BbST2-coro_nb_res.txt");
+#else
+    BenchResults results("BbST-coro_nb_res.txt");
+#endif
+
+    ChronoStopWatch timer;
+#ifdef MINI_BLOCKS
+    BenchArgs args(argc, argv, "kltrmw", "i:");
+#else
+    BenchArgs args(argc, argv, "ktrmw", "i:");
+#endif
+    args.minKExp = 1;
+    vector<int> inFlightCounts = parseInFlightCounts("2,4,8,16,32");
+    int opt; // current option
+
+    while ((opt = args.nextOption()) != -1) {
+        switch (opt) {
+            case 'i':
+                inFlightCounts = parseInFlightCounts(optarg);
+                for (int inFlight: inFlightCounts)
+                    if (inFlight <= 0)
+                        args.fail("Expected in-flight queries counts >=1");
+                break;
+            default: /* '?' */
+                args.usage("[-i in-flight queries counts] ",
+                        "-i [comma separated in-flight queries per thread] (default 2,4,8,16,32)\n");
+        }
+    }
+
+    args.parseSizes();
+    t_array_size n = args.n;
+    t_array_size q = args.q;
+#ifdef MINI_BLOCKS
+    const int miniK = 1 << args.miniKExp;
+#else
+    const int miniK = 0;
+#endif
+
+    if (args.verbose) cout << "Generation of values..." << std::endl;
+    vector<t_value> valuesArray(n);
+#ifdef RANDOM_DATA
+    getRandomValues(valuesArray, MAX_T_VALUE / 4);
+#else
+    getPermutationOfRange(valuesArray);
+#endif
+
+    if (args.verbose) cout << "Generation of queries..." << std::endl;
+    vector<pair<t_array_size, t_array_size>> queriesPairs(q);
+
+    getWorkloadRangeQueries(args.workload, queriesPairs, valuesArray, args.max_range, 1 << args.kExp);
+
+    vector<t_array_size> queries = flattenQueries(queriesPairs, q);
+    t_array_size* resultLoc = new t_array_size[queries.size() / 2];
+
+    omp_set_num_threads(args.noOfThreads);
+    if (args.verbose) cout << "Building BbST... " << std::endl;
+    timer.startTimer();
+#ifdef MINI_BLOCKS
+    BbST solver(&valuesArray[0], valuesArray.size(), args.kExp, args.miniKExp);
+#else
+    BbST solver(&valuesArray[0], valuesArray.size(), args.kExp);
+#endif
+    timer.stopTimer();
+    double buildTime = timer.getElapsedTime();
+    if (args.verbose) cout << "Solving... " << std::endl;
+
+    // plain batch once, then the AMAC and coroutine batches for each in-flight count
+    vector<pair<string, int>> runs = { make_pair(string("plain"), 1) };
+    for (int inFlight: inFlightCounts) {
+        runs.push_back(make_pair(string("amac"), inFlight));
+        runs.push_back(make_pair(string("coro"), inFlight));
+    }
+    if (args.verbose) cout << "query time [ns]; mode; in-flight; n; q; m; size [KB]; k; miniK; noOfThreads; BbST build time [s]; max/min time [ns]" << std::endl;
+    for (const pair<string, int> &run: runs) {
+        vector<double> times;
+        for(int i = 0; i < args.repeats; i++) {
+            cleanCache();
+            timer.startTimer();
+            if (run.first == "plain")
+                solver.rmqBatch(queries, resultLoc);
+            else if (run.first == "amac")
+                solver.rmqBatchInterleaved(queries, resultLoc, run.second);
+            else
+                BbSTCoroutines::rmqBatch(solver, queries, resultLoc, run.second);
+            timer.stopTimer();
+            times.push_back(timer.getElapsedTime());
+        }
+        std::sort(times.begin(), times.end());
+        double nanoqcoef = 1000000000.0 / q;
+        double maxQueryTime = times[args.repeats - 1] * nanoqcoef;
+        double medianQueryTime = times[times.size()/2] * nanoqcoef;
+        double minQueryTime = times[0] * nanoqcoef;
+        ostringstream resultLine;
+        resultLine << medianQueryTime << "\t" << run.first << "\t" << run.second << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << args.max_range
+             << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << args.kExp) << "\t" << miniK << "\t" << args.noOfThreads
+             << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t";
+        results.emit(resultLine);
+        if (args.verification) verify(valuesArray, queries, resultLoc);
+    }
+
+    if (args.verbose) cout << "The end..." << std::endl;
+    return 0;
+}
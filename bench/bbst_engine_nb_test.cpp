@@ -0,0 +1,147 @@
+#include <iostream>
+#include <algorithm>
+
+#include "../utils/testdata.h"
+#include "../utils/timer.h"
+#include "../utils/benchargs.h"
+#include "../bbst.h"
+#include "../bbstengine.h"
+
+#include <unistd.h>
+#include <omp.h>
+
+int main(int argc, char**argv) {
+
+    ChronoStopWatch timer;
+#ifdef MINI_BLOCKS
+    BenchArgs args(argc, argv, "kltrmw", "c:b:o");
+#else
+    BenchArgs args(argc, argv, "ktrmw", "c:b:o");
+#endif
+    args.minKExp = 1;
+    bool ompBaseline = false;
+    int clientsCount = 1;
+    t_array_size batchSize = 1000;
+    int opt; // current option
+
+    while ((opt = args.nextOption()) != -1) {
+        switch (opt) {
+            case 'o':
+                ompBaseline = true;
+                break;
+            case 'c':
+                clientsCount = atoi(optarg);
+                if (clientsCount <= 0)
+                    args.fail("Expected number of clients >=1");
+                break;
+            case 'b':
+                batchSize = atoi(optarg);
+                if (batchSize <= 0)
+                    args.fail("Expected batch size >=1");
+                break;
+            default: /* '?' */
+                args.usage("[-c clients] [-b batch size] [-o] ",
+                        "-c [clients>=1] client threads submitting batches (one at a time)\n-b [batch size>=1] queries per batch\n"
+                        "-o clients call rmqBatch (OpenMP) instead of the query engine (-t: engine workers or OpenMP threads)\n");
+        }
+    }
+
+    args.parseSizes();
+    t_array_size n = args.n;
+    t_array_size q = args.q;
+#ifdef MINI_BLOCKS
+    string rmqName = "BbST2";
+#else
+    string rmqName = "BbST";
+#endif
+    rmqName += ompBaseline ? "-omp" : "-engine";
+    BenchResults results(rmqName + "_nb_res.txt");
+
+    if (args.verbose) cout << "Generation of values..." << std::endl;
+    vector<t_value> valuesArray(n);
+#ifdef RANDOM_DATA
+    getRandomValues(valuesArray, MAX_T_VALUE / 4);
+#else
+    getPermutationOfRange(valuesArray);
+#endif
+
+    if (args.verbose) cout << "Generation of queries..." << std::endl;
+    vector<pair<t_array_size, t_array_size>> queriesPairs(q);
+
+    getWorkloadRangeQueries(args.workload, queriesPairs, valuesArray, args.max_range, 1 << args.kExp);
+
+    vector<t_array_size> queries = flattenQueries(queriesPairs, q);
+    t_array_size* resultLoc = new t_array_size[queries.size() / 2];
+    const t_array_size batchesCount = (q + batchSize - 1) / batchSize;
+    vector<vector<t_array_size>> batches(batchesCount);
+    for (t_array_size b = 0; b < batchesCount; b++)
+        batches[b].assign(queries.begin() + 2 * b * batchSize, queries.begin() + 2 * min(q, (b + 1) * batchSize));
+
+    omp_set_num_threads(args.noOfThreads);
+    if (args.verbose) cout << "Building " << rmqName << "... " << std::endl;
+    timer.startTimer();
+#ifdef MINI_BLOCKS
+    BbST solver(&valuesArray[0], valuesArray.size(), args.kExp, args.miniKExp);
+#else
+    BbST solver(&valuesArray[0], valuesArray.size(), args.kExp);
+#endif
+    timer.stopTimer();
+    double buildTime = timer.getElapsedTime();
+    BbSTQueryEngine<BbST>* engine = ompBaseline ? 0 : new BbSTQueryEngine<BbST>(solver, args.noOfThreads);
+    if (args.verbose) cout << "Solving... " << std::endl;
+
+    vector<double> times;
+    vector<double> latencies(batchesCount);
+    for(int i = 0; i < args.repeats; i++) {
+        cleanCache();
+        timer.startTimer();
+        vector<thread> clients;
+        for (int c = 0; c < clientsCount; c++)
+            clients.push_back(thread([&, c] {
+                // closed loop: each client waits for its batch before submitting the next one
+                for (t_array_size b = c; b < batchesCount; b += clientsCount) {
+                    ChronoStopWatch batchTimer;
+                    batchTimer.startTimer();
+                    if (engine)
+                        engine->submit(batches[b], resultLoc + b * batchSize).get();
+                    else {
+                        omp_set_num_threads(args.noOfThreads);
+                        solver.rmqBatch(batches[b], resultLoc + b * batchSize);
+                    }
+                    batchTimer.stopTimer();
+                    latencies[b] = batchTimer.getElapsedTime();
+                }
+            }));
+        for (thread &client: clients)
+            client.join();
+        timer.stopTimer();
+        times.push_back(timer.getElapsedTime());
+    }
+    delete engine;
+    std::sort(times.begin(), times.end());
+    std::sort(latencies.begin(), latencies.end());
+    double nanoqcoef = 1000000000.0 / q;
+    double maxQueryTime = times[args.repeats - 1] * nanoqcoef ;
+    double medianQueryTime = times[times.size()/2] * nanoqcoef;
+    double minQueryTime = times[0] * nanoqcoef;
+    // batch latency percentiles of the last repeat [us]
+    double p50Latency = latencies[batchesCount / 2] * 1000000;
+    double p99Latency = latencies[(batchesCount * 99) / 100] * 1000000;
+    double p999Latency = latencies[(batchesCount * 999) / 1000] * 1000000;
+#ifdef MINI_BLOCKS
+    const int miniK = 1 << args.miniKExp;
+#else
+    const int miniK = 0;
+#endif
+    if (args.verbose) cout << "query time [ns]; n; q; m; size [KB]; k; miniK; noOfThreads; clients; batch size; build time [s]; max/min time [ns]; batch latency p50/p99/p99.9 [us]" << std::endl;
+    ostringstream resultLine;
+    resultLine << medianQueryTime << "\t" << valuesArray.size() << "\t" << q << "\t" << args.max_range
+         << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << args.kExp) << "\t" << miniK << "\t" << args.noOfThreads
+         << "\t" << clientsCount << "\t" << batchSize << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime
+         << "\t" << p50Latency << "\t" << p99Latency << "\t" << p999Latency << "\t";
+    results.emit(resultLine);
+    if (args.verification) verify(valuesArray, queries, resultLoc);
+
+    if (args.verbose) cout << "The end..." << std::endl;
+    return 0;
+}
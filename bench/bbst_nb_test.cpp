@@ -3,6 +3,9 @@
 
 #include "../utils/testdata.h"
 #include "../utils/timer.h"
+#include "../utils/benchargs.h"
+#include "../utils/perfcounters.h"
+#include "../utils/numareplicas.h"
 #include "../bbst.h"
 
 #include <unistd.h>
@@ -10,100 +13,66 @@
 
 int main(int argc, char**argv) {
 
-    fstream fout("BbST_nb_res.txt", ios::out | ios::binary | ios::app);
+#ifdef CARTESIAN_BLOCKS
+    BenchResults results("BbSTct_nb_res.txt");
+#elif defined(RESULT_CACHE)
+    BenchResults results("BbST-cache_nb_res.txt");
+#else
+    BenchResults results("BbST_nb_res.txt");
+#endif
 
     ChronoStopWatch timer;
-    bool verbose = true;
-    bool verification = false;
-    int kExp = 14;
-    int noOfThreads = 1;
+#ifdef PSEUDO_MONO
+    BenchArgs args(argc, argv, "ktrmwpa", "NC:d:i");
+#else
+    BenchArgs args(argc, argv, "ktrmwpa", "NC:");
+#endif
     int opt; // current option
-    int repeats = 1;
-    t_array_size max_range = 0;
+    bool numaReplicas = false;
 #ifdef PSEUDO_MONO
     t_value delta = 0;
     bool decreasing = true;
-	while ((opt = getopt(argc, argv, "k:t:r:m:d:ivq?")) != -1) {
-#else
-    while ((opt = getopt(argc, argv, "k:t:r:m:vq?")) != -1) {
 #endif
+
+    while ((opt = args.nextOption()) != -1) {
         switch (opt) {
-            case 'q':
-                verbose = false;
-                break;
-            case 'v':
-                verification = true;
-                break;
-            case 'k':
-                kExp = atoi(optarg);
-                if (kExp < 0 || kExp > 24) {
-                    fprintf(stderr, "%s: Expected 24>=k>=0\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+            case 'N':
+                numaReplicas = true;
                 break;
-            case 't':
-                noOfThreads = atoi(optarg);
-                if (noOfThreads <= 0) {
-                    fprintf(stderr, "%s: Expected noOfThreads >=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case 'r':
-                repeats = atoi(optarg);
-                if (repeats <= 0) {
-                    fprintf(stderr, "%s: Expected number of repeats >=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-            case 'm':
-                max_range = atoi(optarg);
-                if (max_range <= 0) {
-                    fprintf(stderr, "%s: Expected maximum size of a range>=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+#ifdef RESULT_CACHE
+            case 'C':
+                if (atoi(optarg) < RMQResultCache::SET_WAYS)
+                    args.fail("Expected result cache entries per thread >=%d", RMQResultCache::SET_WAYS);
+                RMQResultCache::defaultShardCapacity() = atoi(optarg);
                 break;
+#endif
 #ifdef PSEUDO_MONO
             case 'i':
-				decreasing = false;
-				break;
-			case 'd':
-				delta = atoi(optarg);
-				break;
-
+                decreasing = false;
+                break;
+            case 'd':
+                delta = atoi(optarg);
+                break;
 #endif
-            case '?':
             default: /* '?' */
 #ifdef PSEUDO_MONO
-                fprintf(stderr, "Usage: %s [-k block size power of 2 exponent] [-t noOfThreads] [-v] [-q] [-i] [-d delta_value] n q\n\n",
-                        argv[0]);
-				fprintf(stderr, "\n-i pseudo-increasing data");
+                args.usage("[-N] [-C cache entries] [-i] [-d delta_value] ",
+                        "-N replicate tables per NUMA node, pin threads and report per node throughput [Mq/s]\n"
+                        "-C [entries>=4] result cache entries per thread (result cache builds only, reports the hit rate)\n"
+                        "-i pseudo-increasing data\n");
 #else
-                fprintf(stderr, "Usage: %s [-k block size power of 2 exponent] [-t noOfThreads] [-v] [-q] n q\n\n",
-                        argv[0]);
+                args.usage("[-N] [-C cache entries] ",
+                        "-N replicate tables per NUMA node, pin threads and report per node throughput [Mq/s]\n"
+                        "-C [entries>=4] result cache entries per thread (result cache builds only, reports the hit rate)\n");
 #endif
-                fprintf(stderr, "-k [24>=k>=0] \n-t [noOfThreads>=1] \n-v verify results (extremely slow)\n-q quiet output (only parameters)\n\n");
-                exit(EXIT_FAILURE);
         }
     }
 
-    if (optind > (argc - 2)) {
-        fprintf(stderr, "%s: Expected 2 arguments after options (found %d)\n", argv[0], argc-optind);
-        fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-
-        exit(EXIT_FAILURE);
-    }
+    args.parseSizes();
+    t_array_size n = args.n;
+    t_array_size q = args.q;
 
-    t_array_size n = atoi(argv[optind++]);
-    t_array_size q = atoi(argv[optind]);
-    if (max_range == 0) {
-        max_range = n;
-    }
-
-    if (verbose) cout << "Generation of values..." << std::endl;
+    if (args.verbose) cout << "Generation of values..." << std::endl;
     vector<t_value> valuesArray(n);
 #ifdef PSEUDO_MONO
     getPseudoMonotonicValues(valuesArray, delta, decreasing);
@@ -115,45 +84,102 @@ int main(int argc, char**argv) {
 #endif
 #endif
 
-    if (verbose) cout << "Generation of queries..." << std::endl;
+    if (args.verbose) cout << "Generation of queries..." << std::endl;
     vector<pair<t_array_size, t_array_size>> queriesPairs(q);
 
-    getRandomRangeQueries(queriesPairs, n, max_range);
+    getWorkloadRangeQueries(args.workload, queriesPairs, valuesArray, args.max_range, 1 << args.kExp);
 
     vector<t_array_size> queries = flattenQueries(queriesPairs, q);
     t_array_size* resultLoc = new t_array_size[queries.size() / 2];
 
-    omp_set_num_threads(noOfThreads);
-    if (verbose) cout << "Building BbST... " << std::endl;
+    PerfCounters buildCounters(args.perfCounters), queryCounters(args.perfCounters);
+
+    omp_set_num_threads(args.noOfThreads);
+    if (args.verbose) cout << "Building BbST... " << std::endl;
+    buildCounters.startCounters();
     timer.startTimer();
-    BbST solver(&valuesArray[0], valuesArray.size(), kExp);
+    BbST solver(&valuesArray[0], valuesArray.size(), args.kExp);
     timer.stopTimer();
+    buildCounters.stopCounters();
     double buildTime = timer.getElapsedTime();
-    if (verbose) cout << "Solving... " << std::endl;
+    NumaReplicas<BbST>* replicas = 0;
+    double replicationTime = 0;
+    if (numaReplicas) {
+        timer.startTimer();
+        replicas = new NumaReplicas<BbST>(solver);
+        timer.stopTimer();
+        replicationTime = timer.getElapsedTime();
+    }
+    if (args.verbose) cout << "Solving... " << std::endl;
 
     vector<double> times;
-    for(int i = 0; i < repeats; i++) {
+    for(int i = 0; i < args.repeats; i++) {
         cleanCache();
+#ifdef RMQ_STATS
+        RMQStats::instance().reset();
+#endif
+#ifdef RESULT_CACHE
+        solver.getResultCache().clear();
+#endif
+        queryCounters.startCounters();
         timer.startTimer();
-        solver.rmqBatch(queries, resultLoc);
+        if (replicas)
+            replicas->rmqBatch(queries, resultLoc);
+        else
+            solver.rmqBatch(queries, resultLoc);
         timer.stopTimer();
+        queryCounters.stopCounters();
         times.push_back(timer.getElapsedTime());
     }
     std::sort(times.begin(), times.end());
     double nanoqcoef = 1000000000.0 / q;
-    double maxQueryTime = times[repeats - 1] * nanoqcoef ;
+    double maxQueryTime = times[args.repeats - 1] * nanoqcoef ;
     double medianQueryTime = times[times.size()/2] * nanoqcoef;
     double minQueryTime = times[0] * nanoqcoef;
-    if (verbose) cout << "query time [ns]; n; q; m; size [KB]; k; noOfThreads; BbST build time [s]; max/min time [ns]" << std::endl;
-    cout << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << max_range
-         << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << kExp) << "\t" << noOfThreads
-         << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << std::endl;
-    fout << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << max_range <<
-         "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << kExp) << "\t" << noOfThreads <<
-         "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << std::endl;
-    if (verification) verify(valuesArray, queries, resultLoc);
-
-    if (verbose) cout << "The end..." << std::endl;
+    string numaResult;
+    if (replicas) {
+        numaResult = to_string(replicationTime) + "\t";
+        for (size_t i = 0; i < replicas->nodesCount(); i++) {
+            numaResult += to_string(replicas->nodeThroughput(i)) + "\t";
+            if (args.verbose) cout << "NUMA node " << replicas->nodeId(i) << ": " << replicas->nodeThroughput(i) << " Mq/s" << std::endl;
+        }
+    }
+    if (args.verbose) cout << "query time [ns]; n; q; m; size [KB]; k; noOfThreads; BbST build time [s]; max/min time [ns]" << std::endl;
+    if (args.verbose && args.perfCounters) cout << "+ build " PERF_COUNTERS_HEADER " per element; query " PERF_COUNTERS_HEADER " per query" << std::endl;
+    if (args.verbose && replicas) cout << "+ replication time [s]; per NUMA node throughput [Mq/s]" << std::endl;
+    string cacheResult;
+#ifdef RESULT_CACHE
+    // replicas have their own caches, so the hit rate refers to the solver only
+    if (!replicas) {
+        cacheResult = to_string(solver.getResultCache().hitRate()) + "\t";
+        if (args.verbose) cout << "+ result cache hit rate (last repeat)" << std::endl;
+    }
+#endif
+    ostringstream resultLine;
+    resultLine << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << args.max_range
+         << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << args.kExp) << "\t" << args.noOfThreads
+         << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << args.perfColumns(buildCounters, valuesArray.size(), queryCounters, queries.size() / 2.0) << numaResult << cacheResult;
+    results.emit(resultLine);
+#ifdef RMQ_STATS
+    {
+#ifdef CARTESIAN_BLOCKS
+        string statsName = "BbSTct";
+#else
+        string statsName = "BbST";
+#endif
+        RMQStats::instance().dumpJSON(statsName + "_nb_stats.json", statsName, {{"n", (double) n}, {"q", (double) q}, {"m", (double) args.max_range},
+                {"k", (double) (1 << args.kExp)}, {"threads", (double) args.noOfThreads}});
+#ifdef CARTESIAN_BLOCKS
+        // queries which needed the linear scan inside a 64-element block (neither signature answered the range)
+        const RMQStats::ThreadStats statsSum = RMQStats::instance().total();
+        cout << "in-block scans: " << statsSum.count[scanPath] << " of " << (queries.size() / 2) << " queries (last repeat)" << std::endl;
+#endif
+    }
+#endif
+    if (args.verification) verify(valuesArray, queries, resultLoc);
+    delete replicas;
+
+    if (args.verbose) cout << "The end..." << std::endl;
     return 0;
 }
 
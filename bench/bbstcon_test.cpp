@@ -3,138 +3,199 @@
 
 #include "../utils/testdata.h"
 #include "../utils/timer.h"
+#include "../utils/benchargs.h"
+#include "../utils/perfcounters.h"
 #include "../bbstcon.h"
+#include "../sweeprmq.h"
 
 #include <unistd.h>
 #include <omp.h>
 
 int main(int argc, char**argv) {
 
-    fstream fout("BbSTcon_res.txt", ios::out | ios::binary | ios::app);
-
     ChronoStopWatch timer;
-    bool verbose = true;
-    bool verification = false;
-    int kExp = 9;
-    int noOfThreads = 1;
+    BenchArgs args(argc, argv, "ktrmwp", "s:e:F:P:DR");
+    args.kExp = 9;
     sortingAlg_enum sortingAlg = kxradixsort;
     int opt; // current option
-    int repeats = 1;
-    t_array_size max_range = 0;
+    bool reuse = false;
+    double perturbedFraction = 0.1;
+    char engine = 'c';
+    string valuesFile;
+    bool directIO = true;
 
-    while ((opt = getopt(argc, argv, "k:t:s:r:m:vq?")) != -1) {
+    while ((opt = args.nextOption()) != -1) {
         switch (opt) {
-            case 'q':
-                verbose = false;
-                break;
-            case 'v':
-                verification = true;
-                break;
-            case 'k':
-                kExp = atoi(optarg);
-                if (kExp < 0 || kExp > 24) {
-                    fprintf(stderr, "%s: Expected 24>=k>=0\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+            case 'R':
+                reuse = true;
                 break;
-            case 't':
-                noOfThreads = atoi(optarg);
-                if (noOfThreads <= 0) {
-                    fprintf(stderr, "%s: Expected noOfThreads >=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+            case 'P':
+                perturbedFraction = atof(optarg);
+                if (perturbedFraction < 0 || perturbedFraction > 1)
+                    args.fail("Expected 1>=fraction of perturbed queries>=0");
                 break;
-            case 'r':
-                repeats = atoi(optarg);
-                if (repeats <= 0) {
-                    fprintf(stderr, "%s: Expected number of repeats >=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+            case 'F':
+                valuesFile = optarg;
                 break;
-            case 'm':
-                max_range = atoi(optarg);
-                if (max_range <= 0) {
-                    fprintf(stderr, "%s: Expected maximum size of a range>=1\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+            case 'D':
+                directIO = false;
                 break;
             case 's':
                 sortingAlg = (sortingAlg_enum) optarg[0];
                 if (sortingAlg != csort && sortingAlg != ompparallelsort && sortingAlg != pssparallelsort &&
-                        sortingAlg != stdsort && sortingAlg != kxradixsort) {
-                    fprintf(stderr, "%s: Unknown sorting algorithm option.\n", argv[0]);
-                    fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
-                    exit(EXIT_FAILURE);
-                }
+                        sortingAlg != stdsort && sortingAlg != kxradixsort && sortingAlg != ompradixsort)
+                    args.fail("Unknown sorting algorithm option.");
+                break;
+            case 'e':
+                engine = optarg[0];
+                if (engine != 'c' && engine != 's' && engine != 'p')
+                    args.fail("Unknown engine option.");
                 break;
-            case '?':
             default: /* '?' */
-                fprintf(stderr, "Usage: %s [-k block size power of 2 exponent] [-t noOfThreads] [-s sortingAlgorithm] [-m max range size] [-v] [-q] n q\n\n",
-                        argv[0]);
-                fprintf(stderr, "-k [24>=k>=0] \n-t [noOfThreads>=1] \n-s [q-quicksort;s-stdsort;r-kxradixsort;i-psspparallelsort;p-ompparallelsort;\n-v verify results (extremely slow)\n-q quiet output (only parameters)\n\n");
-                exit(EXIT_FAILURE);
+                args.usage("[-s sortingAlgorithm] [-e engine] [-F values file] [-D] [-R] [-P fraction] ",
+                        "-s [q-quicksort;s-stdsort;r-kxradixsort;i-psspparallelsort;p-ompparallelsort;l-ompradixsort]\n"
+                        "-e [c-contracted BbST;s-stack sweep;p-parallel stack sweep] batch engine (sorting and unique bounds only for c)\n"
+                        "-F stream the values from the file (written with n random values if it does not exist, otherwise it has to hold n values) instead of memory (reports read [MB], read time [s], bandwidth [MB/s], O_DIRECT, peak RSS [KB]; with -v also checks that a failed read after an in-memory batch is reported)\n"
+                        "-D read the values file through the page cache instead of O_DIRECT\n"
+                        "-R prepare the contracted structure once and answer the repeated batches with it (reports prepare time [s])\n"
+                        "-P [1>=fraction>=0] fraction of queries of the answered batch replaced by uniform random queries after prepare (with -R, default 0.1)\n");
         }
     }
 
-    if (optind > (argc - 2)) {
-        fprintf(stderr, "%s: Expected 2 arguments after options (found %d)\n", argv[0], argc-optind);
-        fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
+    args.parseSizes();
+    if (reuse && engine != 'c')
+        args.fail("Reuse mode requires the contracted engine");
+    if (!valuesFile.empty() && (reuse || engine != 'c'))
+        args.fail("Values file mode requires the contracted engine without reuse");
 
-        exit(EXIT_FAILURE);
-    }
+    BenchResults results(!valuesFile.empty() ? "BbSTcon-file_res.txt" : engine == 'c' ? "BbSTcon_res.txt" : (engine == 's' ? "SweepRMQ_res.txt" : "SweepRMQ-par_res.txt"));
 
-    t_array_size n = atoi(argv[optind++]);
-    t_array_size q = atoi(argv[optind]);
-    if (max_range == 0) {
-        max_range = n;
-    }
+    t_array_size n = args.n;
+    t_array_size q = args.q;
 
-    if (verbose) cout << "Generation of values..." << std::endl;
-    vector<t_value> valuesArray(n);
+    vector<t_value> valuesArray;
+    if (valuesFile.empty()) {
+        if (args.verbose) cout << "Generation of values..." << std::endl;
+        valuesArray.resize(n);
 #ifdef RANDOM_DATA
-    getRandomValues(valuesArray, MAX_T_VALUE / 4);
+        getRandomValues(valuesArray, MAX_T_VALUE / 4);
 #else
-    getPermutationOfRange(valuesArray);
+        getPermutationOfRange(valuesArray);
 #endif
+    } else {
+        // an existing file is never overwritten
+        if (access(valuesFile.c_str(), F_OK) != 0) {
+            if (args.verbose) cout << "Writing values file..." << std::endl;
+            writeRandomValuesFile(valuesFile, n, MAX_T_VALUE / 4);
+        }
+        fstream fin(valuesFile, ios::in | ios::binary | ios::ate);
+        if (!fin || (size_t) fin.tellg() != (size_t) n * sizeof(t_value)) {
+            fprintf(stderr, "%s: Values file %s cannot be read or its size is not n * %d bytes\n", argv[0], valuesFile.c_str(), (int) sizeof(t_value));
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    if (verbose) cout << "Generation of queries..." << std::endl;
+    if (args.verbose) cout << "Generation of queries..." << std::endl;
     vector<pair<t_array_size, t_array_size>> queriesPairs(q);
-    getRandomRangeQueries(queriesPairs, n, max_range);
+    if (valuesFile.empty())
+        getWorkloadRangeQueries(args.workload, queriesPairs, valuesArray, args.max_range, 1 << args.kExp);
+    else
+        getWorkloadRangeQueries(args.workload, queriesPairs, n, args.max_range);
     vector<t_array_size> queries = flattenQueries(queriesPairs, q);
+    // -R: the structure is prepared for queries and answers the batch with a fraction of queries replaced by uniform ones
+    vector<t_array_size> preparedQueries;
+    if (reuse) {
+        preparedQueries = queries;
+        vector<pair<t_array_size, t_array_size>> redrawnPairs(q);
+        getRandomRangeQueries(redrawnPairs, n, args.max_range);
+        std::mt19937 perturbGenerator(q);
+        std::bernoulli_distribution redraw(perturbedFraction);
+        const vector<t_array_size> redrawnQueries = flattenQueries(redrawnPairs, q);
+        for (t_array_size i = 0; i < q; i++)
+            if (redraw(perturbGenerator)) {
+                queries[2 * i] = redrawnQueries[2 * i];
+                queries[2 * i + 1] = redrawnQueries[2 * i + 1];
+            }
+    }
     t_array_size* resultLoc = new t_array_size[queries.size() / 2];
 
-    BbSTcon solver(sortingAlg, kExp);
-    if (verbose) cout << "Solving... " << std::endl;
+    BbSTcon solver(sortingAlg, args.kExp);
+    SweepRMQ sweepSolver(engine == 'p');
+    if (args.verbose) cout << "Solving... " << std::endl;
+
+    PerfCounters queryCounters(args.perfCounters);
 
-    omp_set_num_threads(noOfThreads);
+    omp_set_num_threads(args.noOfThreads);
+    string reuseResult;
+    if (reuse) {
+        timer.startTimer();
+        solver.prepare(&valuesArray[0], valuesArray.size(), preparedQueries);
+        timer.stopTimer();
+        reuseResult = to_string(timer.getElapsedTime()) + "\t" + to_string(perturbedFraction) + "\t";
+    }
     vector<double> times;
-    for(int i = 0; i < repeats; i++) {
-        if (i > 0) {
+    for(int i = 0; i < args.repeats; i++) {
+        if (i > 0 || reuse) {
             cleanCache();
         }
+        queryCounters.startCounters();
         timer.startTimer();
-        solver.rmqBatch(&valuesArray[0], valuesArray.size(), queries, resultLoc);
+        if (reuse)
+            solver.rmqBatchPrepared(queries, resultLoc);
+        else if (!valuesFile.empty()) {
+            if (!solver.rmqBatchFromFile(valuesFile, queries, resultLoc, 1 << 24, directIO)) {
+                fprintf(stderr, "%s: Cannot read values file %s\n", argv[0], valuesFile.c_str());
+                exit(EXIT_FAILURE);
+            }
+        } else if (engine != 'c')
+            sweepSolver.rmqBatch(&valuesArray[0], valuesArray.size(), queries, resultLoc);
+        else
+            solver.rmqBatch(&valuesArray[0], valuesArray.size(), queries, resultLoc);
         timer.stopTimer();
+        queryCounters.stopCounters();
         times.push_back(timer.getElapsedTime());
     }
     std::sort(times.begin(), times.end());
     double medianTime = times[times.size()/2];
-    if (verbose) cout << "elapsed time [s]; n; q; m; size [KB]; k; sorting; noOfThreads; max/min time [s]" << std::endl;
-    cout << medianTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << max_range <<
-        "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << kExp) <<
-        "\t" << (char) sortingAlg << "\t" << noOfThreads <<
-        "\t" << times[repeats - 1] << "\t" << times[0] << "\t" << std::endl;
-    fout << medianTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << max_range <<
-         "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << kExp) <<
-        "\t" << (char) sortingAlg << "\t" << noOfThreads <<
-        "\t" << times[repeats - 1] << "\t" << times[0] << "\t" << std::endl;
-    if (verification) verify(valuesArray, queries, resultLoc);
+    const size_t memUsage = engine == 'c' ? solver.memUsageInBytes() : sweepSolver.memUsageInBytes();
+    const string sortingResult = engine == 'c' ? string(1, (char) sortingAlg) : "-";
+    const string ratioResult = engine == 'c' ? to_string(solver.compressionRatio()) : "-";
+    string fileResult;
+    if (!valuesFile.empty()) {
+        fileResult = to_string(solver.streamedBytes() / 1e6) + "\t" + to_string(solver.streamingTime()) + "\t" +
+                to_string(solver.streamedBytes() / 1e6 / solver.streamingTime()) + "\t" + (solver.streamedDirect() ? "1" : "0") + "\t" +
+                to_string(peakRSSInKB()) + "\t";
+    }
+    if (args.verbose) cout << "elapsed time [s]; n; q; m; size [KB]; k; sorting; noOfThreads; max/min time [s]; unique bounds ratio" << std::endl;
+    if (args.verbose && args.perfCounters) cout << "+ query " PERF_COUNTERS_HEADER " per query" << std::endl;
+    if (args.verbose && reuse) cout << "+ prepare time [s]; perturbed queries fraction" << std::endl;
+    if (args.verbose && !valuesFile.empty()) cout << "+ read [MB]; read time [s]; disk bandwidth [MB/s]; O_DIRECT; peak RSS [KB] (of the last repeat)" << std::endl;
+    ostringstream resultLine;
+    resultLine << medianTime << "\t" << n << "\t" << (queries.size() / 2) << "\t" << args.max_range <<
+        "\t" << (memUsage / 1000) << "\t" << (1 << args.kExp) <<
+        "\t" << sortingResult << "\t" << args.noOfThreads <<
+        "\t" << times[args.repeats - 1] << "\t" << times[0] << "\t" << ratioResult << "\t" << args.perfColumns(queryCounters, queries.size() / 2.0) << reuseResult << fileResult;
+    results.emit(resultLine);
+    if (args.verification) {
+        if (!valuesFile.empty())
+            readValuesFile(valuesArray, valuesFile);
+        verify(valuesArray, queries, resultLoc);
+    }
+    if (args.verification && !valuesFile.empty()) {
+        // a batch in memory followed by a streamed batch which fails (the file ends before the last bound)
+        const t_array_size lastBound = *std::max_element(queries.begin(), queries.end());
+        if (lastBound > 0) {
+            const string shortValuesFile = valuesFile + ".short";
+            writeRandomValuesFile(shortValuesFile, lastBound, MAX_T_VALUE / 4);
+            solver.rmqBatch(&valuesArray[0], valuesArray.size(), queries, resultLoc);
+            verify(valuesArray, queries, resultLoc);
+            if (solver.rmqBatchFromFile(shortValuesFile, queries, resultLoc, 1 << 24, directIO))
+                cout << "Error: reading a values file shorter than the bounds did not fail" << std::endl;
+            remove(shortValuesFile.c_str());
+        }
+    }
 
-    if (verbose) cout << "The end..." << std::endl;
+    if (args.verbose) cout << "The end..." << std::endl;
     return 0;
 }
 
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <algorithm>
+#include "../utils/testdata.h"
+#include "../utils/timer.h"
+#include "../utils/benchargs.h"
+#include "../utils/perfcounters.h"
+#include "../bbsth.h"
+
+#include <unistd.h>
+#include <omp.h>
+
+vector<int> parseLevelsKExp(const char* levelsStr) {
+    vector<int> levelsKExp;
+    stringstream levelsStream(levelsStr);
+    string kExpStr;
+    while (getline(levelsStream, kExpStr, ','))
+        levelsKExp.push_back(atoi(kExpStr.c_str()));
+    return levelsKExp;
+}
+
+int main(int argc, char**argv) {
+
+    BenchResults results("BbSTh_nb_res.txt");
+
+    ChronoStopWatch timer;
+    BenchArgs args(argc, argv, "trmwpa", "k:");
+    string levelsStr = "6,11,16";
+    vector<int> levelsKExp = parseLevelsKExp(levelsStr.c_str());
+    int opt; // current option
+    while ((opt = args.nextOption()) != -1) {
+        switch (opt) {
+            case 'k':
+                levelsStr = optarg;
+                levelsKExp = parseLevelsKExp(optarg);
+                if (levelsKExp.empty() || levelsKExp.back() > 24)
+                    args.fail("Expected list of levels with 24>=k");
+                for (int l = 0; l < levelsKExp.size(); l++) {
+                    const int delKExp = levelsKExp[l] - (l ? levelsKExp[l - 1] : 0);
+                    if (delKExp < 1 || (l < levelsKExp.size() - 1 && delKExp > 16))
+                        args.fail("Expected ascending levels with 16>=(k_l - k_l-1)>=1 (k_-1=0)");
+                }
+                break;
+            default: /* '?' */
+                args.usage("[-k comma separated levels block size power of 2 exponents] ",
+                        "-k [k_0,k_1,...,k_L; 16>=(k_l - k_l-1)>=1; 24>=k_L] (default 6,11,16)\n");
+        }
+    }
+
+    args.parseSizes();
+    t_array_size n = args.n;
+    t_array_size q = args.q;
+
+    if (args.verbose) cout << "Generation of values..." << std::endl;
+    vector<t_value> valuesArray(n);
+#ifdef RANDOM_DATA
+    getRandomValues(valuesArray, MAX_T_VALUE / 4);
+#else
+    getPermutationOfRange(valuesArray);
+#endif
+
+    if (args.verbose) cout << "Generation of queries..." << std::endl;
+    vector<pair<t_array_size, t_array_size>> queriesPairs(q);
+
+    getWorkloadRangeQueries(args.workload, queriesPairs, valuesArray, args.max_range, 1 << levelsKExp.back());
+
+    vector<t_array_size> queries = flattenQueries(queriesPairs, q);
+    t_array_size* resultLoc = new t_array_size[queries.size() / 2];
+
+    PerfCounters buildCounters(args.perfCounters), queryCounters(args.perfCounters);
+
+    omp_set_num_threads(args.noOfThreads);
+    if (args.verbose) cout << "Building BbSTh... " << std::endl;
+    buildCounters.startCounters();
+    timer.startTimer();
+    BbSTh solver(&valuesArray[0], valuesArray.size(), levelsKExp);
+    timer.stopTimer();
+    buildCounters.stopCounters();
+    double buildTime = timer.getElapsedTime();
+    if (args.verbose) cout << "Solving... " << std::endl;
+
+    vector<double> times;
+    for(int i = 0; i < args.repeats; i++) {
+        cleanCache();
+        queryCounters.startCounters();
+        timer.startTimer();
+        solver.rmqBatch(queries, resultLoc);
+        timer.stopTimer();
+        queryCounters.stopCounters();
+        times.push_back(timer.getElapsedTime());
+    }
+    std::sort(times.begin(), times.end());
+    double nanoqcoef = 1000000000.0 / q;
+    double maxQueryTime = times[args.repeats - 1] * nanoqcoef ;
+    double medianQueryTime = times[times.size()/2] * nanoqcoef;
+    double minQueryTime = times[0] * nanoqcoef;
+    if (args.verbose) cout << "query time [ns]; n; q; m; size [KB]; k; levels; noOfThreads; BbSTh build time [s]; max/min time [ns]" << std::endl;
+    if (args.verbose && args.perfCounters) cout << "+ build " PERF_COUNTERS_HEADER " per element; query " PERF_COUNTERS_HEADER " per query" << std::endl;
+    ostringstream resultLine;
+    resultLine << medianQueryTime << "\t" << valuesArray.size() << "\t" << (queries.size() / 2) << "\t" << args.max_range
+         << "\t" << (solver.memUsageInBytes() / 1000) << "\t" << (1 << levelsKExp.back()) << "\t" << levelsStr << "\t" << args.noOfThreads
+         << "\t" << buildTime << "\t" << maxQueryTime << "\t" << minQueryTime << "\t" << args.perfColumns(buildCounters, valuesArray.size(), queryCounters, queries.size() / 2.0);
+    results.emit(resultLine);
+    if (args.verification) verify(valuesArray, queries, resultLoc);
+
+    if (args.verbose) cout << "The end..." << std::endl;
+    return 0;
+}
@@ -0,0 +1,394 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <ctime>
+#include <cmath>
+
+#include "../common.h"
+
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/wait.h>
+
+// Runs the *_nb benchmark binaries for every combination of parameters from a matrix file and writes the results as
+// CSV and/or JSON together with the environment metadata.
+// The structure is not selected inside one process: the variants are compile time flags (CARTESIAN_BLOCKS,
+// MINI_MASKS, the secondary RMQ, ...), so each variant is a separate executable and the driver runs them (without
+// a shell, each with its own argument vector) instead of linking all of them into one binary.
+//
+// Matrix file: one "key = value value ..." line per parameter (# starts a comment), e.g.
+//   structure = bbst_nb bbst2_nb bbstx_nb bbst-bp_nb
+//   n = 10000000 100000000
+//   q = 1000000
+//   m = 0 1000 1000000      (0 means m = n)
+//   k = 10 12 14
+//   l = 6 7                 (miniK exponent, passed only to bbst2 variants)
+//   t = 1 4
+//   r = 3
+//   s = q r                 (sorting algorithm, passed only to bbstcon)
+//   w = uniform zipf:1.1    (queries workload, see WORKLOAD_USAGE in utils/testdata.h)
+//   a = d t i               (allocation policy of tables, see utils/tablealloc.h)
+//
+// The "query_time_ns" column is the median query time [ns]. It is the first field of the benchmark result line,
+// except for the structures from totalTimeStructures which report the total time [s] of q queries and are divided
+// by q. result_fields keep the whole line. Non-finite times are written as empty CSV fields and JSON nulls.
+
+#ifndef BBST_CXX_FLAGS
+#define BBST_CXX_FLAGS ""
+#endif
+#ifndef BBST_GIT_HASH
+#define BBST_GIT_HASH ""
+#endif
+#ifndef BBST_SOURCE_DIR
+#define BBST_SOURCE_DIR "."
+#endif
+
+const vector<string> matrixKeys = { "structure", "n", "q", "m", "k", "l", "t", "r", "s", "w", "a" };
+// benchmarks whose result line starts with the elapsed time [s] of the whole batch of q queries
+const vector<string> totalTimeStructures = { "bbstcon", "batchrmq_nb" };
+
+typedef struct {
+    map<string, string> params;
+    vector<string> fields;      // tab separated result line of the benchmark
+    double queryTime;           // [ns]
+    double wallTime;
+    bool ok;
+} benchRun;
+
+string trim(const string &str) {
+    const size_t beg = str.find_first_not_of(" \t\r\n");
+    if (beg == string::npos)
+        return "";
+    return str.substr(beg, str.find_last_not_of(" \t\r\n") - beg + 1);
+}
+
+map<string, vector<string>> readMatrix(const char* fileName) {
+    map<string, vector<string>> matrix;
+    ifstream fin(fileName);
+    if (!fin) {
+        fprintf(stderr, "Cannot open matrix file %s\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+    string line;
+    while (getline(fin, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        const size_t eqPos = line.find('=');
+        if (line.empty() || eqPos == string::npos)
+            continue;
+        const string key = trim(line.substr(0, eqPos));
+        if (find(matrixKeys.begin(), matrixKeys.end(), key) == matrixKeys.end()) {
+            fprintf(stderr, "Unknown matrix key %s (expected one of structure, n, q, m, k, l, t, r, s, w, a)\n", key.c_str());
+            exit(EXIT_FAILURE);
+        }
+        stringstream valuesStream(line.substr(eqPos + 1));
+        string value;
+        while (valuesStream >> value)
+            matrix[key].push_back(value);
+    }
+    if (matrix["structure"].empty() || matrix["n"].empty() || matrix["q"].empty()) {
+        fprintf(stderr, "Matrix file requires structure, n and q\n");
+        exit(EXIT_FAILURE);
+    }
+    return matrix;
+}
+
+// cartesian product of the matrix values
+vector<map<string, string>> expandMatrix(const map<string, vector<string>> &matrix) {
+    vector<map<string, string>> runs(1);
+    for(const pair<const string, vector<string>> &entry: matrix) {
+        vector<map<string, string>> expanded;
+        for(const map<string, string> &run: runs)
+            for(const string &value: entry.second) {
+                expanded.push_back(run);
+                expanded.back()[entry.first] = value;
+            }
+        runs.swap(expanded);
+    }
+    return runs;
+}
+
+bool usesMiniBlocks(const string &structure) {
+    return structure.compare(0, 5, "bbst2") == 0 || structure.compare(0, 6, "cbbst2") == 0;
+}
+
+vector<string> benchArguments(const string &binDir, map<string, string> &params) {
+    const string &structure = params["structure"];
+    vector<string> args = { binDir + "/" + structure, "-q" };
+    if (params.count("k")) args.insert(args.end(), { "-k", params["k"] });
+    if (params.count("l")) {
+        if (usesMiniBlocks(structure))
+            args.insert(args.end(), { "-l", params["l"] });
+        else
+            params.erase("l");
+    }
+    if (params.count("t")) args.insert(args.end(), { "-t", params["t"] });
+    if (params.count("r")) args.insert(args.end(), { "-r", params["r"] });
+    if (params.count("m") && params["m"] != "0") args.insert(args.end(), { "-m", params["m"] });
+    if (params.count("w")) args.insert(args.end(), { "-w", params["w"] });
+    if (params.count("a")) {
+        if (structure != "bbstcon")
+            args.insert(args.end(), { "-a", params["a"] });
+        else
+            params.erase("a");
+    }
+    if (params.count("s")) {
+        if (structure == "bbstcon")
+            args.insert(args.end(), { "-s", params["s"] });
+        else
+            params.erase("s");
+    }
+    args.insert(args.end(), { params["n"], params["q"] });
+    return args;
+}
+
+string joinArguments(const vector<string> &args) {
+    string cmd;
+    for(const string &arg: args)
+        cmd += (cmd.empty() ? "" : " ") + arg;
+    return cmd;
+}
+
+// the result line is the last one starting with a number followed by at least 3 tab separated fields
+vector<string> parseResultLine(const string &output) {
+    vector<string> result;
+    stringstream outputStream(output);
+    string line;
+    while (getline(outputStream, line)) {
+        vector<string> fields;
+        stringstream lineStream(line);
+        string field;
+        while (getline(lineStream, field, '\t'))
+            if (!trim(field).empty())
+                fields.push_back(trim(field));
+        char* endPtr;
+        if (fields.size() >= 4 && (strtod(fields[0].c_str(), &endPtr), *endPtr == 0))
+            result = fields;
+    }
+    return result;
+}
+
+string readFirstLine(const string &path) {
+    ifstream fin(path);
+    string line;
+    getline(fin, line);
+    return trim(line);
+}
+
+// runs args[0] (searched in PATH if it has no '/') and returns its stdout and stderr
+string runCommand(const vector<string> &args) {
+    string output;
+    int fds[2];
+    if (pipe(fds) != 0)
+        return output;
+    const pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        vector<char*> argv;
+        for(const string &arg: args)
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        fprintf(stderr, "Cannot execute %s\n", argv[0]);
+        _exit(127);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return output;
+    }
+    char buffer[4096];
+    ssize_t len;
+    while ((len = read(fds[0], buffer, sizeof(buffer))) > 0)
+        output.append(buffer, len);
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+    return output;
+}
+
+double queryTimeNs(const map<string, string> &params, const vector<string> &fields) {
+    if (fields.empty())
+        return NAN;
+    const double time = strtod(fields[0].c_str(), nullptr);
+    if (find(totalTimeStructures.begin(), totalTimeStructures.end(), params.at("structure")) == totalTimeStructures.end())
+        return time;
+    return time * 1e9 / strtod(params.at("q").c_str(), nullptr);
+}
+
+// non-finite values are not valid JSON numbers
+string jsonNumber(double value) {
+    if (!std::isfinite(value))
+        return "null";
+    ostringstream out;
+    out << value;
+    return out.str();
+}
+
+string jsonEscape(const string &str) {
+    string escaped;
+    for(char c: str) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if (c == '\t' || c == '\n')
+            c = ' ';
+        escaped += c;
+    }
+    return escaped;
+}
+
+vector<pair<string, string>> getEnvironmentMetadata() {
+    vector<pair<string, string>> metadata;
+    ifstream cpuinfo("/proc/cpuinfo");
+    string line, cpuModel;
+    while (cpuModel.empty() && getline(cpuinfo, line))
+        if (line.compare(0, 10, "model name") == 0)
+            cpuModel = trim(line.substr(line.find(':') + 1));
+    metadata.push_back(make_pair("cpu_model", cpuModel));
+    metadata.push_back(make_pair("cpu_count", to_string(sysconf(_SC_NPROCESSORS_ONLN))));
+    for(int i = 0; ; i++) {
+        const string cacheDir = "/sys/devices/system/cpu/cpu0/cache/index" + to_string(i) + "/";
+        const string size = readFirstLine(cacheDir + "size");
+        if (size.empty())
+            break;
+        const string type = readFirstLine(cacheDir + "type");
+        const string name = "cache_L" + readFirstLine(cacheDir + "level") + (type == "Data" ? "d" : type == "Instruction" ? "i" : "");
+        metadata.push_back(make_pair(name, size));
+    }
+    char hostName[256] = "";
+    gethostname(hostName, sizeof(hostName) - 1);
+    metadata.push_back(make_pair("host", string(hostName)));
+    metadata.push_back(make_pair("compiler", string(__VERSION__)));
+    metadata.push_back(make_pair("cxx_flags", string(BBST_CXX_FLAGS)));
+    const string gitHash = trim(runCommand({ "git", "-C", BBST_SOURCE_DIR, "rev-parse", "HEAD" }));
+    const bool gitHashValid = gitHash.size() == 40 && gitHash.find_first_not_of("0123456789abcdef") == string::npos;
+    metadata.push_back(make_pair("git_hash", gitHashValid ? gitHash : string(BBST_GIT_HASH)));
+    char timeStr[64];
+    const time_t now = time(0);
+    strftime(timeStr, sizeof(timeStr), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    metadata.push_back(make_pair("date", string(timeStr)));
+    return metadata;
+}
+
+void writeCSV(const string &fileName, const vector<pair<string, string>> &metadata, const vector<benchRun> &runs) {
+    fstream fout(fileName, ios::out | ios::binary | ios::trunc);
+    for(const pair<string, string> &entry: metadata)
+        fout << "# " << entry.first << ": " << entry.second << std::endl;
+    for(const string &key: matrixKeys)
+        fout << key << ",";
+    fout << "query_time_ns,wall_time_s,ok,result_fields" << std::endl;
+    for(const benchRun &run: runs) {
+        for(const string &key: matrixKeys)
+            fout << (run.params.count(key) ? run.params.at(key) : "") << ",";
+        if (std::isfinite(run.queryTime))
+            fout << run.queryTime;
+        fout << "," << run.wallTime << "," << run.ok << ",\"";
+        for(size_t i = 0; i < run.fields.size(); i++)
+            fout << (i ? ";" : "") << run.fields[i];
+        fout << "\"" << std::endl;
+    }
+}
+
+void writeJSON(const string &fileName, const vector<pair<string, string>> &metadata, const vector<benchRun> &runs) {
+    fstream fout(fileName, ios::out | ios::binary | ios::trunc);
+    fout << "{\"environment\": {";
+    for(size_t i = 0; i < metadata.size(); i++)
+        fout << (i ? ", " : "") << "\"" << metadata[i].first << "\": \"" << jsonEscape(metadata[i].second) << "\"";
+    fout << "},\n\"runs\": [";
+    for(size_t r = 0; r < runs.size(); r++) {
+        const benchRun &run = runs[r];
+        fout << (r ? ",\n" : "\n") << "{";
+        for(const pair<const string, string> &param: run.params)
+            fout << "\"" << param.first << "\": \"" << jsonEscape(param.second) << "\", ";
+        fout << "\"query_time_ns\": " << jsonNumber(run.queryTime) << ", \"wall_time_s\": " << jsonNumber(run.wallTime)
+             << ", \"ok\": " << (run.ok ? "true" : "false") << ", \"result_fields\": [";
+        for(size_t i = 0; i < run.fields.size(); i++)
+            fout << (i ? ", " : "") << "\"" << jsonEscape(run.fields[i]) << "\"";
+        fout << "]}";
+    }
+    fout << "\n]}" << std::endl;
+}
+
+int main(int argc, char**argv) {
+
+    bool verbose = true;
+    bool dryRun = false;
+    string csvFileName, jsonFileName;
+    string binDir = string(argv[0]);
+    binDir = binDir.find('/') == string::npos ? "." : binDir.substr(0, binDir.rfind('/'));
+    int opt; // current option
+    while ((opt = getopt(argc, argv, "b:c:j:nq?")) != -1) {
+        switch (opt) {
+            case 'q':
+                verbose = false;
+                break;
+            case 'n':
+                dryRun = true;
+                break;
+            case 'b':
+                binDir = optarg;
+                break;
+            case 'c':
+                csvFileName = optarg;
+                break;
+            case 'j':
+                jsonFileName = optarg;
+                break;
+            case '?':
+            default: /* '?' */
+                fprintf(stderr, "Usage: %s [-b benchmarks directory] [-c results.csv] [-j results.json] [-n] [-q] matrixFile\n\n",
+                        argv[0]);
+                fprintf(stderr, "-b directory with the *_nb binaries (default: directory of %s)\n-c CSV output file\n-j JSON output file\n-n only print commands\n-q quiet output\n\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind > (argc - 1)) {
+        fprintf(stderr, "%s: Expected matrix file after options (found %d arguments)\n", argv[0], argc-optind);
+        fprintf(stderr, "try '%s -?' for more information\n", argv[0]);
+
+        exit(EXIT_FAILURE);
+    }
+
+    vector<map<string, string>> matrixRuns = expandMatrix(readMatrix(argv[optind]));
+    if (csvFileName.empty() && jsonFileName.empty())
+        csvFileName = "bench_results.csv";
+
+    vector<benchRun> runs;
+    for(size_t i = 0; i < matrixRuns.size(); i++) {
+        benchRun run;
+        run.params = matrixRuns[i];
+        const vector<string> args = benchArguments(binDir, run.params);
+        const string cmd = joinArguments(args);
+        if (verbose || dryRun) cout << "[" << (i + 1) << "/" << matrixRuns.size() << "] " << cmd << std::endl;
+        if (dryRun)
+            continue;
+        const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        const string output = runCommand(args);
+        run.wallTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        run.fields = parseResultLine(output);
+        run.queryTime = queryTimeNs(run.params, run.fields);
+        run.ok = !run.fields.empty();
+        if (!run.ok)
+            fprintf(stderr, "No result from: %s\n%s\n", cmd.c_str(), output.c_str());
+        else if (verbose) {
+            for(const string &field: run.fields)
+                cout << field << "\t";
+            cout << std::endl;
+        }
+        runs.push_back(run);
+    }
+    if (dryRun)
+        return 0;
+
+    const vector<pair<string, string>> metadata = getEnvironmentMetadata();
+    if (!csvFileName.empty())
+        writeCSV(csvFileName, metadata, runs);
+    if (!jsonFileName.empty())
+        writeJSON(jsonFileName, metadata, runs);
+
+    if (verbose) cout << "The end..." << std::endl;
+    return 0;
+}
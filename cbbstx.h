@@ -1,21 +1,38 @@
 #ifndef BBST_CBBSTX_H
 #define BBST_CBBSTX_H
 
+#include <atomic>
 #include <vector>
 #include "common.h"
 #include "hybtempl.h"
+#include "utils/fallbacks.h"
+#include "utils/rmqstats.h"
+#include "utils/tablealloc.h"
 
 using namespace std;
 
-template<typename t_qvalue, int max_qvalue>
+class ValuesFileReader;
+
+// Secondary: the secondary structure interface, as in BbSTx
+template<typename t_qvalue, int max_qvalue, class Secondary = RMQAPI>
 class CBbSTx {
 public:
 
 #ifdef MINI_BLOCKS
-    CBbSTx(const vector<t_value> &valuesArray, int kExp, int miniKExp, RMQAPI* secondaryRMQ);
+    CBbSTx(const vector<t_value> &valuesArray, int kExp, int miniKExp, Secondary* secondaryRMQ);
+#else
+    CBbSTx(const vector<t_value> &valuesArray, int kExp, Secondary* secondaryRMQ);
+#endif
+    // streaming build from the values file (see BbSTx, also for the memory of the secondary on sorted values)
+#ifdef MINI_BLOCKS
+    template<class StreamedSecondary>
+    CBbSTx(ValuesFileReader &valuesFile, int kExp, int miniKExp, StreamedSecondary* secondaryRMQ);
 #else
-    CBbSTx(const vector<t_value> &valuesArray, int kExp, RMQAPI* secondaryRMQ);
+    template<class StreamedSecondary>
+    CBbSTx(ValuesFileReader &valuesFile, int kExp, StreamedSecondary* secondaryRMQ);
 #endif
+    // false if the streaming build failed to read the values file
+    bool isBuilt() { return built; }
 
     void rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc);
 
@@ -25,8 +42,19 @@ public:
 
     size_t memUsageInBytes();
 
+    // number of secondary structure queries of the last rmqBatch and the time of answering them [s]
+    size_t fallbacksCount() { return lastFallbacksCount; }
+    double fallbacksTime() { return lastFallbacksSeconds; }
+
 private:
-    RMQAPI* secondaryRMQ;
+#ifdef RMQ_STATS
+    RMQAPI* secondaryRMQ; // RMQStatsProbe of the given one
+#else
+    Secondary* secondaryRMQ;
+#endif
+    atomic<size_t> lastFallbacksCount{0};
+    atomic<double> lastFallbacksSeconds{0};
+    bool built = true;
 
     t_array_size blocksCount;
     int k, kExp, BD, D, miniK, miniKExp;
@@ -40,10 +68,17 @@ private:
     uint8_t* miniBlocksLoc = 0;
     t_qvalue* miniBlocksQVal = 0;
 
+    void allocMinTables(const t_array_size n);
     void prepareMinTables(const vector<t_value> &valuesArray);
+    template<class StreamedSecondary>
+    void prepareMinTablesStreamed(ValuesFileReader &valuesFile, StreamedSecondary* secondaryRMQ);
+    void prepareMinTablesFromMins(vector<t_value> &miniBlocksVal, vector<t_value> &tempBlocksVal, vector<t_array_size> &tempBlocksLoc);
     void prepareBlocksSparseTable(vector<t_value> &tempBlocksVal, vector<t_array_size> &tempBlocksLoc);
     inline t_qvalue quantizeValue(const t_value value);
 
+    // the secondary structure queries go to sink (DirectFallback or DeferredFallbacks of a batch)
+    template<class Sink>
+    inline t_array_size rmqOrDefer(const t_array_size &begIdx, const t_array_size &endIdx, Sink &sink);
     inline t_array_size miniScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_qvalue &qNotSmallerThan);
 
     void cleanup();
@@ -3,33 +3,73 @@
 #include <numeric>
 #include "math.h"
 #include "cbbstx.h"
+#include "utils/blockmins.h"
+#include "utils/valuesfile.h"
 
 #include <omp.h>
 
-template<typename t_qvalue, int max_qvalue> CBbSTx<t_qvalue, max_qvalue>::~CBbSTx() {
+template<typename t_qvalue, int max_qvalue, class Secondary> CBbSTx<t_qvalue, max_qvalue, Secondary>::~CBbSTx() {
     cleanup();
 }
 
 #ifdef MINI_BLOCKS
-template<typename t_qvalue, int max_qvalue> CBbSTx<t_qvalue, max_qvalue>::CBbSTx(const vector<t_value> &valuesArray, int kExp, int miniKExp, RMQAPI* secondaryRMQ) {
+template<typename t_qvalue, int max_qvalue, class Secondary> CBbSTx<t_qvalue, max_qvalue, Secondary>::CBbSTx(const vector<t_value> &valuesArray, int kExp, int miniKExp, Secondary* secondaryRMQ) {
     this->miniKExp = miniKExp;
     this->miniK = 1 << miniKExp;
 #else
-template<typename t_qvalue, int max_qvalue> CBbSTx<t_qvalue, max_qvalue>::CBbSTx(const vector<t_value> &valuesArray, int kExp, RMQAPI* secondaryRMQ) {
+template<typename t_qvalue, int max_qvalue, class Secondary> CBbSTx<t_qvalue, max_qvalue, Secondary>::CBbSTx(const vector<t_value> &valuesArray, int kExp, Secondary* secondaryRMQ) {
 #endif
     this->kExp = kExp;
     this->k = 1 << kExp;
+#ifdef RMQ_STATS
+    this->secondaryRMQ = new RMQStatsProbe(secondaryRMQ);
+#else
     this->secondaryRMQ = secondaryRMQ;
+#endif
     prepareMinTables(valuesArray);
 }
 
-template<typename t_qvalue, int max_qvalue> void CBbSTx<t_qvalue, max_qvalue>::rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+#ifdef MINI_BLOCKS
+template<typename t_qvalue, int max_qvalue, class Secondary> template<class StreamedSecondary> CBbSTx<t_qvalue, max_qvalue, Secondary>::CBbSTx(ValuesFileReader &valuesFile, int kExp, int miniKExp, StreamedSecondary* secondaryRMQ) {
+    this->miniKExp = miniKExp;
+    this->miniK = 1 << miniKExp;
+#else
+template<typename t_qvalue, int max_qvalue, class Secondary> template<class StreamedSecondary> CBbSTx<t_qvalue, max_qvalue, Secondary>::CBbSTx(ValuesFileReader &valuesFile, int kExp, StreamedSecondary* secondaryRMQ) {
+#endif
+    this->kExp = kExp;
+    this->k = 1 << kExp;
+#ifdef RMQ_STATS
+    this->secondaryRMQ = new RMQStatsProbe(secondaryRMQ);
+#else
+    this->secondaryRMQ = secondaryRMQ;
+#endif
+    prepareMinTablesStreamed(valuesFile, secondaryRMQ);
+}
+
+// Secondary structure queries are deferred and answered together at the end, sorted by position
+// (with RMQ_STATS they are answered in place, to be included in the statistics of queries).
+template<typename t_qvalue, int max_qvalue, class Secondary> void CBbSTx<t_qvalue, max_qvalue, Secondary>::rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+#ifdef RMQ_STATS
     for (int i = 0; i < queries.size(); i = i + 2) {
+        RMQ_STATS_QUERY_BEGIN();
         resultLoc[i / 2] = rmq(queries[i], queries[i + 1]);
+        RMQ_STATS_QUERY_END();
     }
+#else
+    DeferredFallbacks fallbacks;
+    for (int i = 0; i < queries.size(); i = i + 2) {
+        const t_array_size result = rmqOrDefer(queries[i], queries[i + 1], fallbacks);
+        resultLoc[i / 2] = result;
+        if (result == MAX_T_ARRAYSIZE)
+            fallbacks.add(i / 2);
+    }
+    fallbacks.finishBatch(secondaryRMQ, resultLoc);
+    lastFallbacksCount = fallbacks.count;
+    lastFallbacksSeconds = fallbacks.seconds;
+#endif
 }
 
-template<typename t_qvalue, int max_qvalue>  inline t_qvalue CBbSTx<t_qvalue, max_qvalue>::quantizeValue(const t_value value) {
+template<typename t_qvalue, int max_qvalue, class Secondary>  inline t_qvalue CBbSTx<t_qvalue, max_qvalue, Secondary>::quantizeValue(const t_value value) {
 //    double valMinMaxRatio = 1 - ((((double) maxMinVal - value)) / (((double) maxMinVal - minMinVal)));
 //    double valMinMaxRatio = 1 - ((((double) maxMinVal - value)*(maxMinVal - value)) / (((double) maxMinVal - minMinVal)*(maxMinVal - minMinVal)));
 //    double valMinMaxRatio = 1 - ((((double) maxMinVal - value)*(maxMinVal - value)*(maxMinVal - value)) / (((double) maxMinVal - minMinVal)*(maxMinVal - minMinVal)*(maxMinVal - minMinVal)));
@@ -47,70 +87,103 @@ template<typename t_qvalue, int max_qvalue>  inline t_qvalue CBbSTx<t_qvalue, ma
     return (max_qvalue - 1) * valMinMaxRatio;
 }
 
-template<typename t_qvalue, int max_qvalue> void CBbSTx<t_qvalue, max_qvalue>::prepareMinTables(const vector<t_value> &valuesArray) {
+template<typename t_qvalue, int max_qvalue, class Secondary> void CBbSTx<t_qvalue, max_qvalue, Secondary>::allocMinTables(const t_array_size n) {
 #ifdef MINI_BLOCKS
-    this->miniBlocksCount = (valuesArray.size() + miniK - 1) >> miniKExp;
-    this->miniBlocksLoc = new uint8_t[miniBlocksCount];
-    vector<t_value> miniBlocksVal(miniBlocksCount);
-    this->miniBlocksQVal = new t_qvalue[miniBlocksCount];
+    this->miniBlocksCount = (n + miniK - 1) >> miniKExp;
+    this->miniBlocksLoc = allocTable<uint8_t>(miniBlocksCount);
+    this->miniBlocksQVal = allocTable<t_qvalue>(miniBlocksCount);
     this->miniBlocksInBlock = k / miniK;
 #endif
-    this->blocksCount = (valuesArray.size() + k - 1) >> kExp;
+    this->blocksCount = (n + k - 1) >> kExp;
     this->D = 32 - __builtin_clz(blocksCount);
     this->BD = 1 + ((D - 1) / 9);
     const t_array_size baseBlocksSize = blocksCount * BD;
     const t_array_size relativeBlocksSize = blocksCount * (D - BD);
+    this->baseBlocksValLoc2D = allocTable<uint8_t>(baseBlocksSize * VALUE_AND_LOCATION_BYTES);
+    this->blocksRelativeLoc2D = allocTable<uint8_t>(relativeBlocksSize);
+}
+
+template<typename t_qvalue, int max_qvalue, class Secondary> void CBbSTx<t_qvalue, max_qvalue, Secondary>::prepareMinTables(const vector<t_value> &valuesArray) {
+    allocMinTables(valuesArray.size());
     vector<t_value> tempBlocksVal(blocksCount);
     vector<t_array_size> tempBlocksLoc(blocksCount);
-    this->baseBlocksValLoc2D = new uint8_t[baseBlocksSize * VALUE_AND_LOCATION_BYTES];
-    this->blocksRelativeLoc2D = new uint8_t[relativeBlocksSize];
 #ifdef MINI_BLOCKS
+    vector<t_value> miniBlocksVal(miniBlocksCount);
 #pragma omp parallel for
     for (t_array_size miniI = 0; miniI < this->miniBlocksCount - 1; miniI++) {
         auto miniMinPtr = std::min_element(&valuesArray[miniI << miniKExp], &valuesArray[(miniI + 1) << miniKExp]);
         miniBlocksVal[miniI] = *miniMinPtr;
         miniBlocksLoc[miniI] = miniMinPtr - &valuesArray[miniI << miniKExp];
     }
-    int delKExp = kExp - miniKExp;
-#pragma omp parallel for
-    for (t_array_size i = 0; i < blocksCount - 1; i++) {
-        auto minPtr = std::min_element(&miniBlocksVal[i << delKExp], &miniBlocksVal[(i + 1) << delKExp]);
-        t_value* valLocPtr = (t_value*) (baseBlocksValLoc2D + VALUE_AND_LOCATION_BYTES * i);
-        *valLocPtr++ = tempBlocksVal[i] = *minPtr;
-        t_array_size miniI = minPtr - &miniBlocksVal[0];
-        *(t_array_size*) valLocPtr = tempBlocksLoc[i] = (miniI << miniKExp) + miniBlocksLoc[miniI];
-    }
+    const t_array_size miniI = this->miniBlocksCount - 1;
+    auto miniMinPtr = std::min_element(&valuesArray[miniI << miniKExp], &(*valuesArray.end()));
+    miniBlocksLoc[miniI] = miniMinPtr - &valuesArray[miniI << miniKExp];
+    miniBlocksVal[miniI] = *miniMinPtr;
 #else
+    vector<t_value> miniBlocksVal;
     #pragma omp parallel for
     for (t_array_size i = 0; i < blocksCount - 1; i++) {
         auto minPtr = std::min_element(&valuesArray[i << kExp], &valuesArray[(i + 1) << kExp]);
-        t_value* valLocPtr = (t_value*) (baseBlocksValLoc2D + VALUE_AND_LOCATION_BYTES * i);
-        *valLocPtr++ = tempBlocksVal[i] = *minPtr;
-        *(t_array_size*) valLocPtr = tempBlocksLoc[i] = minPtr - &valuesArray[0];
+        tempBlocksVal[i] = *minPtr;
+        tempBlocksLoc[i] = minPtr - &valuesArray[0];
     }
+    auto minPtr = std::min_element(&valuesArray[(blocksCount - 1) << kExp], &(*valuesArray.end()));
+    tempBlocksVal[blocksCount - 1] = *minPtr;
+    tempBlocksLoc[blocksCount - 1] = minPtr - &valuesArray[0];
 #endif
+    prepareMinTablesFromMins(miniBlocksVal, tempBlocksVal, tempBlocksLoc);
+}
 
-#ifdef MINI_BLOCKS
-    t_array_size miniI = (blocksCount - 1) << (kExp - miniKExp);
-    for (; ((miniI + 1) << miniKExp) < valuesArray.size(); miniI++) {
-        auto miniMinPtr = std::min_element(&valuesArray[miniI << miniKExp], &valuesArray[(miniI + 1) << miniKExp]);
-        miniBlocksLoc[miniI] = miniMinPtr - &valuesArray[miniI << miniKExp];
-        miniBlocksVal[miniI] = *miniMinPtr;
+// block (mini-block) minima are merged chunk by chunk, as are the values of the secondary structure;
+// mini-block minima are quantized when all are known
+template<typename t_qvalue, int max_qvalue, class Secondary> template<class StreamedSecondary> void CBbSTx<t_qvalue, max_qvalue, Secondary>::prepareMinTablesStreamed(ValuesFileReader &valuesFile, StreamedSecondary* secondaryRMQ) {
+    const t_array_size n = valuesFile.size();
+    if (!valuesFile.isOpen() || n == 0) {
+        built = false;
+        blocksCount = miniBlocksCount = D = BD = 0;
+        return;
     }
-    auto miniMinPtr = std::min_element(&valuesArray[miniI << miniKExp], &(*valuesArray.end()));
-    miniBlocksLoc[miniI] = miniMinPtr - &valuesArray[miniI << miniKExp];
-    miniBlocksVal[miniI] = *miniMinPtr;
-    auto minPtr = std::min_element(&miniBlocksVal[blocksCount - 1 << delKExp], &miniBlocksVal[miniBlocksCount]);
-    t_value* valLocPtr = (t_value*) (baseBlocksValLoc2D + VALUE_AND_LOCATION_BYTES * (blocksCount - 1));
-    *valLocPtr++ = tempBlocksVal[blocksCount - 1] = *minPtr;
-    miniI = minPtr - &miniBlocksVal[0];
-    *(t_array_size*) valLocPtr = tempBlocksLoc[blocksCount - 1] = (miniI << miniKExp) + miniBlocksLoc[miniI];
+    allocMinTables(n);
+    vector<t_value> tempBlocksVal(blocksCount);
+    vector<t_array_size> tempBlocksLoc(blocksCount);
+#ifdef MINI_BLOCKS
+    vector<t_value> miniBlocksVal(miniBlocksCount);
 #else
-    auto minPtr = std::min_element(&valuesArray[(blocksCount - 1) << kExp], &(*valuesArray.end()));
-    t_value* valLocPtr = (t_value*) (baseBlocksValLoc2D + VALUE_AND_LOCATION_BYTES * (blocksCount - 1));
-    *valLocPtr++ = tempBlocksVal[blocksCount - 1] = *minPtr;
-    *(t_array_size*) valLocPtr = tempBlocksLoc[blocksCount - 1] = minPtr - &valuesArray[0];
+    vector<t_value> miniBlocksVal;
+#endif
+    built = valuesFile.stream(0, n, [&](const t_value* values, t_array_size begIdx, t_array_size count) {
+#ifdef MINI_BLOCKS
+        appendBlocksMins(values, begIdx, count, miniKExp, &miniBlocksVal[0], miniBlocksLoc, true);
+#else
+        appendBlocksMins(values, begIdx, count, kExp, &tempBlocksVal[0], &tempBlocksLoc[0], false);
 #endif
+        secondaryRMQ->appendValues(values, count);
+    });
+    if (!built)
+        return;
+    secondaryRMQ->finishBuild();
+    prepareMinTablesFromMins(miniBlocksVal, tempBlocksVal, tempBlocksLoc);
+}
+
+// block minima from mini-block minima (MINI_BLOCKS) or given in tempBlocksVal/Loc, then the sparse table
+template<typename t_qvalue, int max_qvalue, class Secondary> void CBbSTx<t_qvalue, max_qvalue, Secondary>::prepareMinTablesFromMins(vector<t_value> &miniBlocksVal, vector<t_value> &tempBlocksVal, vector<t_array_size> &tempBlocksLoc) {
+#ifdef MINI_BLOCKS
+    const int delKExp = kExp - miniKExp;
+#pragma omp parallel for
+    for (t_array_size i = 0; i < blocksCount; i++) {
+        const t_array_size endMiniI = i < blocksCount - 1 ? (i + 1) << delKExp : miniBlocksCount;
+        auto minPtr = std::min_element(&miniBlocksVal[i << delKExp], &miniBlocksVal[0] + endMiniI);
+        tempBlocksVal[i] = *minPtr;
+        t_array_size miniI = minPtr - &miniBlocksVal[0];
+        tempBlocksLoc[i] = (miniI << miniKExp) + miniBlocksLoc[miniI];
+    }
+#endif
+    #pragma omp parallel for
+    for (t_array_size i = 0; i < blocksCount; i++) {
+        t_value* valLocPtr = (t_value*) (baseBlocksValLoc2D + VALUE_AND_LOCATION_BYTES * i);
+        *valLocPtr++ = tempBlocksVal[i];
+        *(t_array_size*) valLocPtr = tempBlocksLoc[i];
+    }
 #ifdef MINI_BLOCKS
     minMinVal = miniBlocksVal[0];
     maxMinVal = miniBlocksVal[0];
@@ -130,7 +203,7 @@ template<typename t_qvalue, int max_qvalue> void CBbSTx<t_qvalue, max_qvalue>::p
     prepareBlocksSparseTable(tempBlocksVal, tempBlocksLoc);
 }
 
-template<typename t_qvalue, int max_qvalue> void CBbSTx<t_qvalue, max_qvalue>::prepareBlocksSparseTable(vector<t_value> &tempBlocksVal, vector<t_array_size> &tempBlocksLoc) {
+template<typename t_qvalue, int max_qvalue, class Secondary> void CBbSTx<t_qvalue, max_qvalue, Secondary>::prepareBlocksSparseTable(vector<t_value> &tempBlocksVal, vector<t_array_size> &tempBlocksLoc) {
     t_array_size eBDoffset = 0;
     t_array_size eRDoffset = 0;
     for(t_array_size e = 1, step = 1; e < D; ++e, step <<= 1) {
@@ -168,7 +241,12 @@ template<typename t_qvalue, int max_qvalue> void CBbSTx<t_qvalue, max_qvalue>::p
     }
 }
 
-template<typename t_qvalue, int max_qvalue> t_array_size CBbSTx<t_qvalue, max_qvalue>::rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+template<typename t_qvalue, int max_qvalue, class Secondary> t_array_size CBbSTx<t_qvalue, max_qvalue, Secondary>::rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+    DirectFallback direct;
+    return rmqOrDefer(begIdx, endIdx, direct);
+}
+
+template<typename t_qvalue, int max_qvalue, class Secondary> template<class Sink> inline t_array_size CBbSTx<t_qvalue, max_qvalue, Secondary>::rmqOrDefer(const t_array_size &begIdx, const t_array_size &endIdx, Sink &sink) {
     if (begIdx == endIdx) {
         return begIdx;
     }
@@ -183,12 +261,12 @@ template<typename t_qvalue, int max_qvalue> t_array_size CBbSTx<t_qvalue, max_qv
         if (begIdx <= firstBlockMinLoc && firstBlockMinLoc <= endIdx)
             return firstBlockMinLoc;
 #ifndef MINI_BLOCKS
-        return secondaryRMQ->rmq(begIdx, endIdx);
+        return sink.query(secondaryRMQ, begIdx, endIdx);
 #else
         t_qvalue qMiniNotSmallerThen = max_qvalue;
         t_array_size minIdx = miniScanMinIdx(begIdx, endIdx, qMiniNotSmallerThen);
         if (minIdx == MAX_T_ARRAYSIZE) {
-            return secondaryRMQ->rmq(begIdx, endIdx);
+            return sink.query(secondaryRMQ, begIdx, endIdx);
         }
         return minIdx;
 #endif
@@ -214,7 +292,7 @@ template<typename t_qvalue, int max_qvalue> t_array_size CBbSTx<t_qvalue, max_qv
     if (begIdx <= result && result <= endIdx)
         return result;
 #ifndef MINI_BLOCKS
-    return secondaryRMQ->rmq(begIdx, endIdx);
+    return sink.query(secondaryRMQ, begIdx, endIdx);
 #else
     t_qvalue qMiniNotSmallerThen = max_qvalue;
     if (kBlockCount == 1) {
@@ -224,13 +302,13 @@ template<typename t_qvalue, int max_qvalue> t_array_size CBbSTx<t_qvalue, max_qv
             if (minIdx == MAX_T_ARRAYSIZE) {
                 if (qMiniNotSmallerThen > minQVal)
                     return *(t_array_size *) (leftMinValLocPtr + 1);
-                return secondaryRMQ->rmq(begIdx, endIdx);
+                return sink.query(secondaryRMQ, begIdx, endIdx);
             } else {
                 if (miniBlocksQVal[minIdx >> miniKExp] < minQVal)
                     return minIdx;
                 if (miniBlocksQVal[minIdx >> miniKExp] > minQVal)
                     return *(t_array_size *) (leftMinValLocPtr + 1);
-                return secondaryRMQ->rmq(begIdx, endIdx);
+                return sink.query(secondaryRMQ, begIdx, endIdx);
             }
         } else if (*(t_array_size*) (rightMinValLocPtr + 1) <= endIdx) {
             t_qvalue minQVal = quantizeValue(*rightMinValLocPtr);
@@ -238,20 +316,20 @@ template<typename t_qvalue, int max_qvalue> t_array_size CBbSTx<t_qvalue, max_qv
             if (minIdx == MAX_T_ARRAYSIZE) {
                 if (qMiniNotSmallerThen > minQVal)
                     return *(t_array_size *) (rightMinValLocPtr + 1);
-                return secondaryRMQ->rmq(begIdx, endIdx);
+                return sink.query(secondaryRMQ, begIdx, endIdx);
             } else {
                 if (miniBlocksQVal[minIdx >> miniKExp] < minQVal)
                     return minIdx;
                 if (miniBlocksQVal[minIdx >> miniKExp] > minQVal)
                     return *(t_array_size *) (rightMinValLocPtr + 1);
-                return secondaryRMQ->rmq(begIdx, endIdx);
+                return sink.query(secondaryRMQ, begIdx, endIdx);
             }
         }
     }
     if (kBlockCount <= 1) {
         t_array_size minIdx = miniScanMinIdx(begIdx, endIdx, qMiniNotSmallerThen);
         if (minIdx == MAX_T_ARRAYSIZE)
-            return secondaryRMQ->rmq(begIdx, endIdx);
+            return sink.query(secondaryRMQ, begIdx, endIdx);
         return minIdx;
     }
 
@@ -353,23 +431,24 @@ template<typename t_qvalue, int max_qvalue> t_array_size CBbSTx<t_qvalue, max_qv
         t_array_size minIdx = miniScanMinIdx(endCompIdx << kExp, endIdx, qMiniNotSmallerThen);
         if (minIdx == MAX_T_ARRAYSIZE) {
             if (qMiniNotSmallerThen <= minQVal)
-                return secondaryRMQ->rmq(begIdx, endIdx);
+                return sink.query(secondaryRMQ, begIdx, endIdx);
         } else {
             if (miniBlocksQVal[minIdx >> miniKExp] < minQVal) {
                 return minIdx;
             } else if (miniBlocksQVal[minIdx >> miniKExp] == minQVal) {
-                return secondaryRMQ->rmq(begIdx, endIdx);
+                return sink.query(secondaryRMQ, begIdx, endIdx);
             }
         }
     }
     if (uncertainResult) {
-        return secondaryRMQ->rmq(begIdx, endIdx);
+        return sink.query(secondaryRMQ, begIdx, endIdx);
     }
     return result;
 #endif
 }
 
-template<typename t_qvalue, int max_qvalue> inline t_array_size CBbSTx<t_qvalue, max_qvalue>::miniScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_qvalue &qNotSmallerThan) {
+template<typename t_qvalue, int max_qvalue, class Secondary> inline t_array_size CBbSTx<t_qvalue, max_qvalue, Secondary>::miniScanMinIdx(const t_array_size &begIdx, const t_array_size &endIdx, t_qvalue &qNotSmallerThan) {
+    RMQ_STATS_PATH(miniPath);
     t_array_size result = -1;
     const t_array_size begMiniIdx = begIdx >> miniKExp;
     const t_array_size endMiniIdx = endIdx >> miniKExp;
@@ -426,16 +505,19 @@ template<typename t_qvalue, int max_qvalue> inline t_array_size CBbSTx<t_qvalue,
     return result;
 }
 
-template<typename t_qvalue, int max_qvalue> void CBbSTx<t_qvalue, max_qvalue>::cleanup() {
-    delete[] this->blocksRelativeLoc2D;
-    delete[] this->baseBlocksValLoc2D;
+template<typename t_qvalue, int max_qvalue, class Secondary> void CBbSTx<t_qvalue, max_qvalue, Secondary>::cleanup() {
+    freeTable(this->blocksRelativeLoc2D);
+    freeTable(this->baseBlocksValLoc2D);
 #ifdef MINI_BLOCKS
-    delete[] this->miniBlocksLoc;
-    delete[] this->miniBlocksQVal;
+    freeTable(this->miniBlocksLoc);
+    freeTable(this->miniBlocksQVal);
+#endif
+#ifdef RMQ_STATS
+    delete this->secondaryRMQ;
 #endif
 }
 
-template<typename t_qvalue, int max_qvalue> size_t CBbSTx<t_qvalue, max_qvalue>::memUsageInBytes() {
+template<typename t_qvalue, int max_qvalue, class Secondary> size_t CBbSTx<t_qvalue, max_qvalue, Secondary>::memUsageInBytes() {
     size_t bytes = blocksCount * (D - BD) * (sizeof(uint8_t));
     bytes += blocksCount * BD *(sizeof(t_value) + sizeof(t_array_size));
 #ifdef MINI_BLOCKS
@@ -5,27 +5,50 @@
 
 class RMQAPI {
 public:
-    virtual t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx);
-    virtual size_t memUsageInBytes();
+    virtual t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx) = 0;
+    virtual size_t memUsageInBytes() = 0;
+    virtual ~RMQAPI() {}
+
+    // answers count queries given as (begIdx, endIdx) pairs in ranges (sorted by begIdx when called by the hybrids)
+    virtual void rmqBatch(const t_array_size* ranges, const size_t count, t_array_size* resultLoc) {
+        for (size_t i = 0; i < count; i++)
+            resultLoc[i] = rmq(ranges[2 * i], ranges[2 * i + 1]);
+    }
+};
+
+// A secondary structure that can be built from values streamed in order (appendValues for consecutive chunks),
+// ready for queries after finishBuild.
+class StreamedRMQAPI: public RMQAPI {
+public:
+    virtual void appendValues(const t_value* values, const t_array_size count) = 0;
+    virtual void finishBuild() = 0;
 };
 
 class RMQCounter: public RMQAPI {
 private:
     uint64_t counter = 0;
+    uint64_t rangesLength = 0;
 public:
     t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
         counter++;
+        rangesLength += endIdx - begIdx + 1;
         return MAX_T_ARRAYSIZE;
     }
 
     void resetCounter() {
         counter = 0;
+        rangesLength = 0;
     }
 
     uint64_t getRMQCount() {
         return counter;
     }
 
+    // total length of ranges passed to the secondary structure
+    uint64_t getRMQRangesLength() {
+        return rangesLength;
+    }
+
     size_t memUsageInBytes() {
         return 0;
     }
@@ -21,6 +21,7 @@
 #define RMQRMM64_H_
 
 #include "Basic_rmq.h"
+#include <vector>
 using namespace std;
 using namespace rmqrmm;
 
@@ -28,6 +29,7 @@ using namespace rmqrmm;
 // Standard Configuration !
 #define BLK 256		// size of blocks (BLK bits each one), (power of 2 >= W)
 #define SS 256		// select_1 sampling size. Power of 2
+#define QCHUNK 1048576	// values of Q spilled to a temporary file at once by the streaming construction
 
 // ___________________________________________________
 // FIXIED VALUES:
@@ -159,6 +161,19 @@ private:
 
 	uint sizeRMM;			// in bytes
 
+	// creates the BP sequence P for A[0..len-1] (valueAt(i) returns A[i]) in parallel and returns the number of parentheses
+	template<typename ValueAt> ulong createBPSequence(ValueAt valueAt, ulong len);
+
+	vector<int> streamQ;	// top values (at most 2*QCHUNK) of the stack Q during the streaming construction
+	FILE *streamQFile = 0;	// bottom of Q, in chunks of QCHUNK values (0 until Q first grows beyond 2*QCHUNK)
+	ulong streamQChunks = 0;	// number of chunks of Q in streamQFile
+	ulong streamPos;		// number of parentheses appended by the streaming construction
+
+	// moves the QCHUNK bottom values of streamQ to streamQFile
+	void spillStreamQ();
+	// moves the last chunk of streamQFile to the empty streamQ
+	void reloadStreamQ();
+
 public:
 	ulong nP;				// Length of sequence P (n parentheses and n/2 nodes)
 
@@ -179,6 +194,14 @@ public:
 	RMQRMM64(char *fileName);
 	virtual ~RMQRMM64();
 
+	// streaming construction for A[0..len-1]: the cells are passed in order, in chunks of any length, to appendValues
+	// and the structure is ready for queries after finishBuild. Only the values of Q are kept besides P.
+	// Q holds the values of the current right path of the Cartesian tree: a few for random data, but up to len values
+	// for increasing or nearly sorted A; at most 2*QCHUNK of them are kept in memory, the rest goes to a temporary file.
+	RMQRMM64(ulong len);
+	void appendValues(const int *A, ulong count);
+	void finishBuild();
+
 	void createMinMaxTree();
 	void createTables();
 
@@ -26,8 +26,10 @@
 #define NOMINMAX 
 #include <windows.h>
 #include <io.h>
-#else
+#elif defined(_WIN32)
 #include "mman/mman.h"
+#else
+#include <sys/mman.h>
 #endif
 
 namespace sdsl
@@ -68,14 +68,33 @@ namespace sdsl
     private:
         
         //! Calculates the maximum depth of a leaf in the BP sequence.
+        /*! Chunks of the sequence are scanned in parallel for their excess and maximal prefix excess,
+         *  which are then combined sequentially.
+         */
         void calculate_maximum_excess_value() {
-            m_max_excess = std::numeric_limits<bit_vector::value_type>::min();
-            bit_vector::value_type cur_excess = 0;
-            for(size_t i = 0; i < m_v->size(); ++i) {
-                if((*m_v)[i]) cur_excess++;
-                else cur_excess--;
-                if(cur_excess > m_max_excess) m_max_excess = cur_excess;
+            typedef bit_vector::difference_type difference_type;
+            const size_t size = m_v->size();
+            const size_t chunk_size = 1ULL << 20;
+            const size_t chunks_count = (size + chunk_size - 1) / chunk_size;
+            std::vector<difference_type> chunk_excess(chunks_count), chunk_max(chunks_count);
+            #pragma omp parallel for
+            for(size_t c = 0; c < chunks_count; ++c) {
+                difference_type cur_excess = 0, max_excess = std::numeric_limits<difference_type>::min();
+                const size_t end = std::min(size, (c + 1) * chunk_size);
+                for(size_t i = c * chunk_size; i < end; ++i) {
+                    if((*m_v)[i]) cur_excess++;
+                    else cur_excess--;
+                    if(cur_excess > max_excess) max_excess = cur_excess;
+                }
+                chunk_excess[c] = cur_excess;
+                chunk_max[c] = max_excess;
+            }
+            difference_type cur_excess = 0, max_excess = 0;
+            for(size_t c = 0; c < chunks_count; ++c) {
+                if(c == 0 || cur_excess + chunk_max[c] > max_excess) max_excess = cur_excess + chunk_max[c];
+                cur_excess += chunk_excess[c];
             }
+            m_max_excess = max_excess;
             if(m_v->size() <= 2) m_max_excess = 1;
         }        
         
@@ -83,6 +102,7 @@ namespace sdsl
         void generate_select_sample() {
             size_t N = m_v->size()/2;
             m_select_sample = int_vector<>(N/t_sample_size+2,0);
+            #pragma omp parallel for
             for(size_t i = 1; i < N; i += t_sample_size) {
                 m_select_sample[i/t_sample_size] = select(i,0,false);
             }
@@ -23,6 +23,10 @@
 
 #include <stack>
 #include <limits>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "rmq_support.hpp"
 #include "int_vector.hpp"
@@ -258,6 +262,111 @@ class rmq_succinct_rec
             return max_excess;
         }
 
+        //! Chunks of the parallel construction of the BP sequence (see plan_generalized_cartesian_tree_parallel).
+        struct gct_chunks {
+            size_t chunk_len;
+            std::vector<size_t> chunk_pos;                    // position of the first parenthesis of each chunk
+            std::vector<std::vector<size_t>> extra_closings;  // closing parentheses of each prefix minimum of a chunk
+                                                              // for values of previous chunks
+        };
+
+        //! Chunked parallel version of the stack algorithm of construct_generalized_cartesian_tree_leftmost(_reverse).
+        /*! v (read from the end if reverse) is split into one chunk per thread and each chunk runs its own stack
+         *  (popping values > the current one if strict, >= otherwise). A chunk knows all its parentheses except the
+         *  closing ones that its prefix minima append for values of previous chunks, so the stacks left by the chunks
+         *  are merged sequentially to count these, the position of each chunk and the maximal excess (returned).
+         */
+        template<class t_rac>
+        static bit_vector::value_type plan_generalized_cartesian_tree_parallel(const t_rac* v, bool reverse, bool strict, gct_chunks& chunks) {
+            typedef typename t_rac::value_type t_val;
+            const size_t n = v->size();
+            size_t chunks_count = n >> 16;
+#ifdef _OPENMP
+            if (chunks_count > (size_t) omp_get_max_threads()) chunks_count = omp_get_max_threads();
+#else
+            chunks_count = std::min(chunks_count, (size_t) 1);
+#endif
+            if (chunks_count == 0) chunks_count = 1;
+            chunks.chunk_len = (n + chunks_count - 1) / chunks_count;
+            chunks.chunk_pos.assign(chunks_count + 1, 0);
+            chunks.extra_closings.assign(chunks_count, std::vector<size_t>());
+            std::vector<std::vector<t_val>> rest_s(chunks_count), prefix_mins(chunks_count);
+            std::vector<std::vector<size_t>> segment_max(chunks_count);  // max local stack size from each prefix minimum
+
+            #pragma omp parallel for schedule(static, 1)
+            for (size_t c = 0; c < chunks_count; ++c) {
+                std::vector<t_val>& s = rest_s[c];
+                const size_t end = std::min(n, (c + 1) * chunks.chunk_len);
+                for (size_t i = c * chunks.chunk_len; i < end; ++i) {
+                    const t_val cur_elem = (*v)[reverse ? n - 1 - i : i];
+                    while (!s.empty() && (strict ? s.back() > cur_elem : s.back() >= cur_elem))
+                        s.pop_back();
+                    if (s.empty()) {
+                        prefix_mins[c].push_back(cur_elem);
+                        segment_max[c].push_back(0);
+                    }
+                    s.push_back(cur_elem);
+                    if (s.size() > segment_max[c].back()) segment_max[c].back() = s.size();
+                }
+            }
+
+            size_t max_excess = 0;
+            std::vector<t_val> s;
+            chunks.chunk_pos[0] = 1;
+            for (size_t c = 0; c < chunks_count; ++c) {
+                const size_t beg = std::min(n, c * chunks.chunk_len), end = std::min(n, (c + 1) * chunks.chunk_len);
+                size_t closings = (end - beg) - rest_s[c].size();
+                for (size_t k = 0; k < prefix_mins[c].size(); ++k) {
+                    size_t extra = 0;
+                    while (!s.empty() && (strict ? s.back() > prefix_mins[c][k] : s.back() >= prefix_mins[c][k])) {
+                        s.pop_back();
+                        extra++;
+                    }
+                    chunks.extra_closings[c].push_back(extra);
+                    closings += extra;
+                    if (s.size() + segment_max[c][k] > max_excess) max_excess = s.size() + segment_max[c][k];
+                }
+                s.insert(s.end(), rest_s[c].begin(), rest_s[c].end());
+                std::vector<t_val>().swap(rest_s[c]);
+                chunks.chunk_pos[c + 1] = chunks.chunk_pos[c] + (end - beg) + closings;
+            }
+            return max_excess;
+        }
+
+        //! Writes the opening parentheses planned by plan_generalized_cartesian_tree_parallel to m_gct_bp
+        //! (the words shared by neighbouring chunks are updated atomically).
+        template<class t_rac>
+        void construct_generalized_cartesian_tree_parallel(const t_rac* v, bool reverse, bool strict, const gct_chunks& chunks) {
+            typedef typename t_rac::value_type t_val;
+            const size_t n = v->size();
+            if (n == 0) return;
+            uint64_t* data = m_gct_bp.data();
+            data[0] |= 1ULL;
+            const size_t chunks_count = chunks.extra_closings.size();
+            #pragma omp parallel for schedule(static, 1)
+            for (size_t c = 0; c < chunks_count; ++c) {
+                std::vector<t_val> s;
+                const size_t first_w = chunks.chunk_pos[c] >> 6, last_w = (chunks.chunk_pos[c + 1] - 1) >> 6;
+                const size_t end = std::min(n, (c + 1) * chunks.chunk_len);
+                size_t bp_cur_pos = chunks.chunk_pos[c], k = 0;
+                for (size_t i = c * chunks.chunk_len; i < end; ++i) {
+                    const t_val cur_elem = (*v)[reverse ? n - 1 - i : i];
+                    while (!s.empty() && (strict ? s.back() > cur_elem : s.back() >= cur_elem)) {
+                        s.pop_back();
+                        bp_cur_pos++;
+                    }
+                    if (s.empty()) bp_cur_pos += chunks.extra_closings[c][k++];
+                    const size_t w = bp_cur_pos >> 6;
+                    if (w == first_w || w == last_w)
+                        __sync_fetch_and_or(&data[w], 1ULL << (bp_cur_pos & 63));
+                    else
+                        data[w] |= 1ULL << (bp_cur_pos & 63);
+                    bp_cur_pos++;
+                    s.push_back(cur_elem);
+                }
+            }
+        }
+
         template<class t_rac>
         void construct_generalized_cartesian_tree_leftmost_recursive(const t_rac* v) {
             if (v->size() > 0) {
@@ -289,8 +398,10 @@ class rmq_succinct_rec
             size_type bp_size = m_gct_bp.size();
             m_min_excess = int_vector<>(bp_size/t_super_block_size+1,0);
             m_min_excess_idx = int_vector<>(bp_size/t_super_block_size+1,0);
-            bit_vector::difference_type min_rel_ex = 0;
-            for (size_t i = 0; i*t_super_block_size < bp_size; ++i) {
+            const size_t super_blocks = (bp_size + t_super_block_size - 1) / t_super_block_size;
+            #pragma omp parallel for
+            for (size_t i = 0; i < super_blocks; ++i) {
+                bit_vector::difference_type min_rel_ex = 0;
                 uint64_t min_idx = near_rmq(m_gct_bp,i*t_super_block_size, std::min((i+1)*t_super_block_size - 1,bp_size-1),min_rel_ex);
                 m_min_excess_idx[i] = min_idx-i*t_super_block_size;
                 m_min_excess[i] = m_rank_select.excess(min_idx);
@@ -362,12 +473,14 @@ class rmq_succinct_rec
                     m_max_excess_v = 1; m_max_excess_reverse_v = 0;
                     construct_generalized_cartesian_tree_leftmost_recursive(v);
                 } else {
-                    m_max_excess_v = construct_generalized_cartesian_tree_leftmost(v,false);
-                    m_max_excess_reverse_v = construct_generalized_cartesian_tree_leftmost_reverse(v,false);
+                    // same as construct_generalized_cartesian_tree_leftmost(_reverse), in parallel
+                    gct_chunks chunks, chunks_reverse;
+                    m_max_excess_v = plan_generalized_cartesian_tree_parallel(v, false, true, chunks);
+                    m_max_excess_reverse_v = plan_generalized_cartesian_tree_parallel(v, true, false, chunks_reverse);
                     if (m_max_excess_v < m_max_excess_reverse_v) {
-                        construct_generalized_cartesian_tree_leftmost(v);
+                        construct_generalized_cartesian_tree_parallel(v, false, true, chunks);
                     } else {
-                        construct_generalized_cartesian_tree_leftmost_reverse(v);
+                        construct_generalized_cartesian_tree_parallel(v, true, false, chunks_reverse);
                     }
                 }
 //                     std::cout << m_max_excess_v << " " << m_max_excess_reverse_v << std::endl;
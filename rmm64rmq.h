@@ -0,0 +1,48 @@
+#ifndef BBST_RMM64RMQ_H
+#define BBST_RMM64RMQ_H
+
+#include "hybtempl.h"
+#include "includes/RMQRMM64.h"
+
+// RMQRMM64 builds its balanced parentheses directly from the values array (read only, not copied)
+// or from values streamed in order (constructed for n values, then appendValues and finishBuild).
+class RMM64RMQ final: public StreamedRMQAPI {
+private:
+    RMQRMM64 *rmqImpl;
+public:
+
+    RMM64RMQ(const t_value* valuesArray, const t_array_size n) {
+        rmqImpl = new RMQRMM64((t_value*) valuesArray, n);
+    }
+
+    RMM64RMQ(const t_array_size n) {
+        rmqImpl = new RMQRMM64((ulong) n);
+    }
+
+    ~RMM64RMQ() {
+        delete rmqImpl;
+    }
+
+    void appendValues(const t_value* values, const t_array_size count) {
+        rmqImpl->appendValues(values, count);
+    }
+
+    void finishBuild() {
+        rmqImpl->finishBuild();
+    }
+
+    t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+        return rmqImpl->queryRMQ(begIdx, endIdx);
+    }
+
+    void rmqBatch(const t_array_size* ranges, const size_t count, t_array_size* resultLoc) {
+        for (size_t i = 0; i < count; i++)
+            resultLoc[i] = rmqImpl->queryRMQ(ranges[2 * i], ranges[2 * i + 1]);
+    }
+
+    size_t memUsageInBytes() {
+        return rmqImpl->getSize();
+    }
+};
+
+#endif //BBST_RMM64RMQ_H
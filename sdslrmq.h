@@ -0,0 +1,65 @@
+#ifndef BBST_SDSLRMQ_H
+#define BBST_SDSLRMQ_H
+
+#include "hybtempl.h"
+#include "includes/sdsl/rmq_support.hpp"
+
+// Read-only random access view of the values array for the construction of sdsl rmq structures (t_rac).
+// The values are mapped to unsigned ones preserving the order (the sign bit flipped) when read, as sdsl constructors
+// use std::numeric_limits<value_type>::min() as the stack bottom, so the array is not copied to an int_vector.
+class BiasedValuesView {
+private:
+    const t_value* valuesArray;
+    t_array_size n;
+public:
+    typedef uint32_t value_type;
+    typedef uint64_t size_type;
+
+    BiasedValuesView(const t_value* valuesArray, const t_array_size n): valuesArray(valuesArray), n(n) {}
+
+    size_type size() const {
+        return n;
+    }
+
+    value_type operator[](const size_type i) const {
+        return (uint32_t) valuesArray[i] ^ 0x80000000u;
+    }
+};
+
+template<class rmqStruct>
+class SdslRMQ final: public RMQAPI {
+private:
+    rmqStruct *rmqImpl;
+public:
+
+    SdslRMQ(const t_value* valuesArray, const t_array_size n) {
+        BiasedValuesView view(valuesArray, n);
+        rmqImpl = new rmqStruct(&view);
+    }
+
+    ~SdslRMQ() {
+        delete rmqImpl;
+    }
+
+    t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+        return rmqImpl->operator()(begIdx, endIdx);
+    }
+
+    void rmqBatch(const t_array_size* ranges, const size_t count, t_array_size* resultLoc) {
+        for (size_t i = 0; i < count; i++)
+            resultLoc[i] = rmqImpl->operator()(ranges[2 * i], ranges[2 * i + 1]);
+    }
+
+    size_t memUsageInBytes() {
+        return sdsl::size_in_bytes(*rmqImpl);
+    }
+};
+
+typedef SdslRMQ<sdsl::rmq_succinct_rec<>> SdslRecRMQ;
+typedef SdslRMQ<sdsl::rmq_succinct_rec_new<true, 1024, 128, 0>> SdslRecNewRMQ;
+typedef SdslRMQ<sdsl::rmq_succinct_sct<>> SdslSctRMQ;
+typedef SdslRMQ<sdsl::rmq_succinct_sada<>> SdslSadaRMQ;
+typedef SdslRMQ<sdsl::rmq_succinct_bp<>> SdslBPRMQ;
+typedef SdslRMQ<sdsl::rmq_succinct_bp_fast<>> SdslBPFastRMQ;
+
+#endif //BBST_SDSLRMQ_H
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <iostream>
+#include "sweeprmq.h"
+#include "utils/kxsort.h"
+
+#include <omp.h>
+
+SweepRMQ::SweepRMQ(bool parallel) {
+    this->parallel = parallel;
+}
+
+void SweepRMQ::rmqBatch(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries, t_array_size *resultLoc) {
+    this->valuesArray = valuesArray;
+    this->n = n;
+    this->q = queries.size() / 2;
+    distributeQueries(queries, resultLoc);
+    if (chunksCount > 1)
+        rightPartLoc = new t_array_size[q];
+    chunkMinLoc.assign(chunksCount, 0);
+    #pragma omp parallel for schedule(dynamic) num_threads(parallel ? omp_get_max_threads() : 1)
+    for(int c = 0; c < chunksCount; c++)
+        sweepChunk(c, queries, resultLoc);
+    if (chunksCount > 1)
+        combineCrossingQueries(queries, resultLoc);
+    cleanup();
+}
+
+void SweepRMQ::distributeQueries(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+    const int threadsCount = parallel ? omp_get_max_threads() : 1;
+    chunksCount = min((t_array_size) threadsCount, n);
+    chunkSize = (n + chunksCount - 1) / chunksCount;
+    chunksCount = (n + chunkSize - 1) / chunkSize;
+    vector<t_array_size> counts((size_t) threadsCount * chunksCount, 0);
+    chunkEntriesOffsets.assign(chunksCount + 1, 0);
+    #pragma omp parallel num_threads(threadsCount)
+    {
+        t_array_size* threadCounts = &counts[(size_t) omp_get_thread_num() * chunksCount];
+        #pragma omp for schedule(static)
+        for(long long int i = 0; i < q; i++) {
+            const t_array_size begIdx = queries[2 * i];
+            const t_array_size endIdx = queries[2 * i + 1];
+            if (begIdx == endIdx) {
+                resultLoc[i] = begIdx;
+                continue;
+            }
+            threadCounts[begIdx / chunkSize]++;
+            if (begIdx / chunkSize != endIdx / chunkSize)
+                threadCounts[endIdx / chunkSize]++;
+        }
+        #pragma omp single
+        {
+            t_array_size sum = 0;
+            for(t_array_size c = 0; c < chunksCount; c++) {
+                chunkEntriesOffsets[c] = sum;
+                for(int t = 0; t < threadsCount; t++) {
+                    const t_array_size count = counts[(size_t) t * chunksCount + c];
+                    counts[(size_t) t * chunksCount + c] = sum;
+                    sum += count;
+                }
+            }
+            chunkEntriesOffsets[chunksCount] = sum;
+            chunkEntries = new t_array_size[sum];
+        }
+        // the same static schedule as in counting, so each thread fills its own ranges of chunks
+        #pragma omp for schedule(static)
+        for(long long int i = 0; i < q; i++) {
+            const t_array_size begIdx = queries[2 * i];
+            const t_array_size endIdx = queries[2 * i + 1];
+            if (begIdx == endIdx)
+                continue;
+            chunkEntries[threadCounts[begIdx / chunkSize]++] = i;
+            if (begIdx / chunkSize != endIdx / chunkSize)
+                chunkEntries[threadCounts[endIdx / chunkSize]++] = i;
+        }
+    }
+}
+
+struct CutsWord {
+    uint64_t bits;
+    t_array_size rank;      // number of cuts in the previous words
+};
+
+// number of cuts before pos
+inline t_array_size cutsRank(const CutsWord* cuts, const t_array_size pos) {
+    return cuts[pos >> 6].rank + __builtin_popcountll(cuts[pos >> 6].bits & ((1ULL << (pos & 63)) - 1));
+}
+
+inline t_array_size nextCut(const CutsWord* cuts, const t_array_size wordsCount, const t_array_size pos, const t_array_size length) {
+    t_array_size w = pos >> 6;
+    uint64_t bits = cuts[w].bits & (~0ULL << (pos & 63));
+    while (!bits) {
+        if (++w == wordsCount)
+            return length;
+        bits = cuts[w].bits;
+    }
+    return (w << 6) + __builtin_ctzll(bits);
+}
+
+struct SweepEntry {
+    t_array_size answerSegment;
+    t_array_size begSegment;    // MAX_T_ARRAYSIZE for the right parts of queries crossing from the previous chunks
+    t_array_size queryIdx;
+};
+
+struct RadixTraitsSweepEntry {
+    static const int nBytes = sizeof(t_array_size);
+    int kth_byte(const SweepEntry &x, int k) {
+        return x.answerSegment >> (k * 8) & 0xFF;
+    }
+    bool compare(const SweepEntry &a, const SweepEntry &b) {
+        return a.answerSegment < b.answerSegment;
+    }
+};
+
+void SweepRMQ::sweepChunk(const t_array_size chunk, const vector<t_array_size> &queries, t_array_size *resultLoc) {
+    const t_array_size begChunkIdx = chunk * chunkSize;
+    const t_array_size length = min(n - begChunkIdx, chunkSize);
+    const t_array_size* entries = chunkEntries + chunkEntriesOffsets[chunk];
+    const t_array_size entriesCount = chunkEntriesOffsets[chunk + 1] - chunkEntriesOffsets[chunk];
+    const t_value* chunkValues = valuesArray + begChunkIdx;
+
+    // the chunk is cut into segments at left ends and after right ends of queries,
+    // so the stack runs over the minima of segments instead of all values
+    const t_array_size wordsCount = (length >> 6) + 1;
+    CutsWord* cuts = new CutsWord[wordsCount]();
+    cuts[0].bits = 1;
+    for(t_array_size e = 0; e < entriesCount; e++) {
+        const t_array_size begIdx = queries[2 * entries[e]];
+        const t_array_size endIdx = queries[2 * entries[e] + 1];
+        if (begIdx >= begChunkIdx)
+            cuts[(begIdx - begChunkIdx) >> 6].bits |= 1ULL << ((begIdx - begChunkIdx) & 63);
+        if (endIdx < begChunkIdx + length)
+            cuts[(endIdx + 1 - begChunkIdx) >> 6].bits |= 1ULL << ((endIdx + 1 - begChunkIdx) & 63);
+    }
+    cuts[length >> 6].bits &= ~(1ULL << (length & 63));
+    t_array_size segmentsCount = 0;
+    for(t_array_size w = 0; w < wordsCount; w++) {
+        cuts[w].rank = segmentsCount;
+        segmentsCount += __builtin_popcountll(cuts[w].bits);
+    }
+
+    // entries sorted by the segment they are answered at: the segment ending at the right end
+    // or the last segment for suffixes of queries crossing to the next chunks
+    SweepEntry* sweepEntries = new SweepEntry[entriesCount + 1];
+    for(t_array_size e = 0; e < entriesCount; e++) {
+        const t_array_size begIdx = queries[2 * entries[e]];
+        const t_array_size endIdx = queries[2 * entries[e] + 1];
+        sweepEntries[e].answerSegment = endIdx < begChunkIdx + length ? cutsRank(cuts, endIdx + 1 - begChunkIdx) - 1 : segmentsCount - 1;
+        sweepEntries[e].begSegment = begIdx >= begChunkIdx ? cutsRank(cuts, begIdx - begChunkIdx) : MAX_T_ARRAYSIZE;
+        sweepEntries[e].queryIdx = entries[e];
+    }
+    kx::radix_sort(sweepEntries, sweepEntries + entriesCount, RadixTraitsSweepEntry());
+    sweepEntries[entriesCount].answerSegment = segmentsCount;
+
+    // increasing segments of suffix minima (an equal minimum does not pop the leftmost one)
+    vector<t_array_size> minStack;
+    vector<t_value> minStackValues;
+    vector<t_array_size> minStackLoc;
+    t_array_size prefixMinLoc = begChunkIdx;
+    SweepEntry* entry = sweepEntries;
+    t_array_size segmentBeg = 0;
+    for(t_array_size s = 0; s < segmentsCount; s++) {
+        const t_array_size segmentEnd = nextCut(cuts, wordsCount, segmentBeg + 1, length);
+        const t_value *const minPtr = std::min_element(chunkValues + segmentBeg, chunkValues + segmentEnd);
+        const t_value value = *minPtr;
+        segmentBeg = segmentEnd;
+        while (!minStackValues.empty() && minStackValues.back() > value) {
+            minStack.pop_back();
+            minStackValues.pop_back();
+            minStackLoc.pop_back();
+        }
+        minStack.push_back(s);
+        minStackValues.push_back(value);
+        minStackLoc.push_back(begChunkIdx + (minPtr - chunkValues));
+        if (value < valuesArray[prefixMinLoc])
+            prefixMinLoc = minStackLoc.back();
+        for(; entry->answerSegment == s; entry++) {
+            if (entry->begSegment != MAX_T_ARRAYSIZE)
+                resultLoc[entry->queryIdx] = minStackLoc[std::lower_bound(minStack.begin(), minStack.end(), entry->begSegment) - minStack.begin()];
+            else
+                rightPartLoc[entry->queryIdx] = prefixMinLoc;
+        }
+    }
+    chunkMinLoc[chunk] = prefixMinLoc;
+    delete[] sweepEntries;
+    delete[] cuts;
+}
+
+void SweepRMQ::combineCrossingQueries(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+    // locations of minima of all ranges of chunks
+    vector<t_array_size> chunksRangeMinLoc((size_t) chunksCount * chunksCount);
+    for(t_array_size a = 0; a < chunksCount; a++) {
+        t_array_size minLoc = chunkMinLoc[a];
+        for(t_array_size b = a; b < chunksCount; b++) {
+            if (valuesArray[chunkMinLoc[b]] < valuesArray[minLoc])
+                minLoc = chunkMinLoc[b];
+            chunksRangeMinLoc[(size_t) a * chunksCount + b] = minLoc;
+        }
+    }
+    #pragma omp parallel for num_threads(parallel ? omp_get_max_threads() : 1)
+    for(long long int i = 0; i < q; i++) {
+        const t_array_size begChunk = queries[2 * i] / chunkSize;
+        const t_array_size endChunk = queries[2 * i + 1] / chunkSize;
+        if (begChunk == endChunk)
+            continue;
+        t_array_size result = resultLoc[i];
+        if (endChunk > begChunk + 1) {
+            const t_array_size minLoc = chunksRangeMinLoc[(size_t) (begChunk + 1) * chunksCount + endChunk - 1];
+            if (valuesArray[minLoc] < valuesArray[result])
+                result = minLoc;
+        }
+        if (valuesArray[rightPartLoc[i]] < valuesArray[result])
+            result = rightPartLoc[i];
+        resultLoc[i] = result;
+    }
+}
+
+void SweepRMQ::cleanup() {
+    delete[] this->chunkEntries;
+    this->chunkEntries = 0;
+    delete[] this->rightPartLoc;
+    this->rightPartLoc = 0;
+}
+
+size_t SweepRMQ::memUsageInBytes() {
+    const size_t entriesBytes = chunkEntriesOffsets.empty() ? 0 : chunkEntriesOffsets[chunksCount] * sizeof(t_array_size);
+    const size_t rightPartBytes = chunksCount > 1 ? q * sizeof(t_array_size) : 0;
+    // cuts of the chunks swept at the same time and sorted entries (stacks omitted)
+    const size_t cutsBytes = (size_t) min((t_array_size) (parallel ? omp_get_max_threads() : 1), chunksCount) * ((chunkSize >> 6) + 1) * sizeof(CutsWord);
+    return entriesBytes + rightPartBytes + cutsBytes + entriesBytes / sizeof(t_array_size) * sizeof(SweepEntry);
+}
@@ -0,0 +1,45 @@
+#ifndef SWEEPRMQ_H
+#define SWEEPRMQ_H
+
+#include <vector>
+#include "common.h"
+
+using namespace std;
+
+// Offline batch RMQ without a sparse table: the array is swept once with a monotone stack of suffix minima and
+// each query is answered when the sweep reaches its right end, by the leftmost stack entry not before its left end.
+// The array is cut into segments at the bounds of queries, so the stack runs over minima of segments
+// (std::min_element scans between bounds) and the queries grouped by the segments of their right ends.
+// O(n + q log s) time (s - stack size) and O(q + n/4) bytes of memory.
+// The parallel variant sweeps one chunk of the array per thread; a query crossing chunks is answered by the sweep
+// of the chunk of its left end (suffix of the chunk), the prefix minimum of the chunk of its right end
+// and the minima of the chunks in between.
+class SweepRMQ {
+public:
+    SweepRMQ(bool parallel);
+
+    void rmqBatch(const t_value* valuesArray, const t_array_size n, const vector<t_array_size> &queries, t_array_size *resultLoc);
+
+    size_t memUsageInBytes();
+
+private:
+    bool parallel;
+    const t_value *valuesArray;
+    t_array_size n;
+    size_t q;
+
+    t_array_size chunksCount, chunkSize;
+    vector<t_array_size> chunkEntriesOffsets;
+    t_array_size* chunkEntries = 0;         // query indexes grouped by chunks (a crossing query is in two chunks)
+    t_array_size* rightPartLoc = 0;         // prefix minima of the chunks of the right ends of crossing queries
+    vector<t_array_size> chunkMinLoc;
+
+    void distributeQueries(const vector<t_array_size> &queries, t_array_size *resultLoc);
+    void sweepChunk(const t_array_size chunk, const vector<t_array_size> &queries, t_array_size *resultLoc);
+    void combineCrossingQueries(const vector<t_array_size> &queries, t_array_size *resultLoc);
+
+    void cleanup();
+};
+
+
+#endif //SWEEPRMQ_H
@@ -0,0 +1,48 @@
+#ifndef ARGMIN_H
+#define ARGMIN_H
+
+// std::min_element for t_value ranges with AVX2: each of 8 lanes keeps its minimum and the first position it was
+// found at (strict comparison), so the leftmost minimum of the range is returned, as by std::min_element.
+
+#include <algorithm>
+#include "../common.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+inline const t_value* minElement(const t_value* begin, const t_value* end) {
+#ifdef __AVX2__
+    const size_t length = end - begin;
+    if (length < 16)
+        return std::min_element(begin, end);
+    __m256i minVal = _mm256_loadu_si256((const __m256i*) begin);
+    __m256i minIdx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i curIdx = minIdx;
+    const __m256i step = _mm256_set1_epi32(8);
+    size_t i = 8;
+    for(; i + 8 <= length; i += 8) {
+        const __m256i val = _mm256_loadu_si256((const __m256i*) (begin + i));
+        curIdx = _mm256_add_epi32(curIdx, step);
+        const __m256i less = _mm256_cmpgt_epi32(minVal, val);
+        minVal = _mm256_min_epi32(minVal, val);
+        minIdx = _mm256_blendv_epi8(minIdx, curIdx, less);
+    }
+    alignas(32) t_value lanesVal[8];
+    alignas(32) uint32_t lanesIdx[8];
+    _mm256_store_si256((__m256i*) lanesVal, minVal);
+    _mm256_store_si256((__m256i*) lanesIdx, minIdx);
+    size_t result = lanesIdx[0];
+    for(int l = 1; l < 8; l++)
+        if (lanesVal[l] < begin[result] || (lanesVal[l] == begin[result] && lanesIdx[l] < result))
+            result = lanesIdx[l];
+    for(; i < length; i++)
+        if (begin[i] < begin[result])
+            result = i;
+    return begin + result;
+#else
+    return std::min_element(begin, end);
+#endif
+}
+
+#endif //ARGMIN_H
@@ -0,0 +1,217 @@
+#ifndef BENCHARGS_H
+#define BENCHARGS_H
+
+// Command line and result lines shared by the bench mains.
+// BenchArgs parses the common options given in commonOptions (of "kltrmwpa", -v and -q always) and returns the
+// options of the main (ownOptions, getopt syntax) from nextOption:
+//     BenchArgs args(argc, argv, "ktrmwpa", "F:D");
+//     args.kExp = 12;
+//     while ((opt = args.nextOption()) != -1) {
+//         switch (opt) {
+//             case 'F': ...
+//             case 'D': ...
+//             default: args.usage("[-F values file] [-D] ", "-F ...\n-D ...\n");
+//         }
+//     }
+//     args.parseSizes(); // n q
+// BenchResults writes each result line (tab-separated fields) to the standard output and appends it to the results file.
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "../common.h"
+#include "perfcounters.h"
+#include "tablealloc.h"
+#include "testdata.h"
+
+using namespace std;
+
+class BenchArgs {
+public:
+    bool verbose = true;
+    bool verification = false;
+    int kExp = 14;
+    int minKExp = 0;        // smallest -k accepted
+    int miniKExp = 7;
+    int noOfThreads = 1;
+    int repeats = 1;
+    t_array_size max_range = 0;   // n unless given
+    string workload = "uniform";
+    bool perfCounters = false;
+    t_array_size n = 0, q = 0;
+
+    BenchArgs(int argc, char** argv, const string &commonOptions, const string &ownOptions): argc(argc), argv(argv),
+            commonOptions(commonOptions) {
+        for (char opt: commonOptions) {
+            optString += opt;
+            if (opt != 'p')
+                optString += ':';
+        }
+        optString += ownOptions + "vq?";
+    }
+
+    // next option of the main (the common ones are parsed on the way), -1 after the last one
+    int nextOption() {
+        int opt;
+        while ((opt = getopt(argc, argv, optString.c_str())) != -1)
+            if (!parseCommon(opt))
+                return opt;
+        return -1;
+    }
+
+    // prints "program: message" and exits
+    void fail(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        fprintf(stderr, "%s: ", argv[0]);
+        vfprintf(stderr, format, args);
+        va_end(args);
+        fprintf(stderr, "\ntry '%s -?' for more information\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // prints the options (the common ones first, then ownSynopsis and ownDescription of the main) and exits
+    void usage(const char* ownSynopsis, const char* ownDescription) {
+        string synopsis, description;
+        for (char opt: commonOptions) {
+            switch (opt) {
+                case 'k':
+                    synopsis += "[-k block size power of 2 exponent] ";
+                    description += "-k [24>=k>=" + to_string(minKExp) + "] \n";
+                    break;
+                case 'l':
+                    synopsis += "[-l miniblock size power of 2 exponent] ";
+                    description += "-l [8>=l>=0] \n";
+                    break;
+                case 't':
+                    synopsis += "[-t noOfThreads] ";
+                    description += "-t [noOfThreads>=1] \n";
+                    break;
+                case 'r':
+                    synopsis += "[-r repeats] ";
+                    description += "-r [repeats>=1] repeated batches (median, max and min time reported)\n";
+                    break;
+                case 'm':
+                    synopsis += "[-m max range size] ";
+                    description += "-m [m>=1] maximum size of a query range (default n)\n";
+                    break;
+                case 'w':
+                    synopsis += "[-w workload] ";
+                    description += WORKLOAD_USAGE;
+                    break;
+                case 'p':
+                    synopsis += "[-p] ";
+                    description += "-p report hardware performance counters (" PERF_COUNTERS_HEADER ") per element (build) and per query\n";
+                    break;
+                case 'a':
+                    synopsis += "[-a allocation policy] ";
+                    description += ALLOC_POLICY_USAGE;
+                    break;
+            }
+        }
+        fprintf(stderr, "Usage: %s %s%s[-v] [-q] n q\n\n", argv[0], synopsis.c_str(), ownSynopsis);
+        fprintf(stderr, "%s%s-v verify results (extremely slow)\n-q quiet output (only parameters)\n\n", description.c_str(), ownDescription);
+        exit(EXIT_FAILURE);
+    }
+
+    // n and q after the options (and checks that blocks are larger than miniblocks)
+    void parseSizes() {
+        if (optind > (argc - 2))
+            fail("Expected 2 arguments after options (found %d)", argc - optind);
+        if (commonOptions.find('l') != string::npos && kExp <= miniKExp)
+            fail("k block size must be greater than miniblock size (k=%d, l=%d)", kExp, miniKExp);
+        n = atoi(argv[optind++]);
+        q = atoi(argv[optind]);
+        if (max_range == 0)
+            max_range = n;
+    }
+
+    // hardware counter columns of a result line ("" without -p): per query of all the repeated batches of batchSize
+    // queries (and per element of the build of n elements)
+    string perfColumns(PerfCounters &queryCounters, double batchSize) {
+        return perfCounters ? queryCounters.getRatios(batchSize * repeats) + "\t" : "";
+    }
+    string perfColumns(PerfCounters &buildCounters, double n, PerfCounters &queryCounters, double batchSize) {
+        return perfCounters ? buildCounters.getRatios(n) + "\t" + perfColumns(queryCounters, batchSize) : "";
+    }
+
+private:
+    int argc;
+    char** argv;
+    string commonOptions;
+    string optString;
+
+    bool parseCommon(int opt) {
+        switch (opt) {
+            case 'q':
+                verbose = false;
+                return true;
+            case 'v':
+                verification = true;
+                return true;
+            case '?':
+                return false;
+        }
+        if (commonOptions.find((char) opt) == string::npos)
+            return false;
+        switch (opt) {
+            case 'k':
+                kExp = atoi(optarg);
+                if (kExp < minKExp || kExp > 24)
+                    fail("Expected 24>=k>=%d", minKExp);
+                break;
+            case 'l':
+                miniKExp = atoi(optarg);
+                if (miniKExp < 0 || miniKExp > 8)
+                    fail("Expected 8>=l>=0");
+                break;
+            case 't':
+                noOfThreads = atoi(optarg);
+                if (noOfThreads <= 0)
+                    fail("Expected noOfThreads >=1");
+                break;
+            case 'r':
+                repeats = atoi(optarg);
+                if (repeats <= 0)
+                    fail("Expected number of repeats >=1");
+                break;
+            case 'm':
+                if (atoi(optarg) <= 0)
+                    fail("Expected maximum size of a range>=1");
+                max_range = atoi(optarg);
+                break;
+            case 'w':
+                workload = optarg;
+                break;
+            case 'p':
+                perfCounters = true;
+                break;
+            case 'a':
+                if (!isAllocPolicy(optarg[0]))
+                    fail("Unknown allocation policy %s", optarg);
+                tableAllocPolicy() = (allocPolicy_enum) optarg[0];
+                break;
+        }
+        return true;
+    }
+};
+
+class BenchResults {
+public:
+    BenchResults(const string &fileName): fout(fileName, ios::out | ios::binary | ios::app) {}
+
+    void emit(const ostringstream &line) {
+        cout << line.str() << std::endl;
+        fout << line.str() << std::endl;
+    }
+
+private:
+    fstream fout;
+};
+
+#endif //BENCHARGS_H
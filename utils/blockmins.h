@@ -0,0 +1,32 @@
+#ifndef BLOCKMINS_H
+#define BLOCKMINS_H
+
+// Minima of consecutive blocks of 2^blockExp values streamed in order, in chunks of any length
+// (chunk boundaries need not match the block ones). The first part of a block sets its minimum and the next parts
+// replace it only with a smaller value, so the leftmost minimum is kept. Locations are positions in the array
+// or offsets in blocks (offsetLoc).
+
+#include "argmin.h"
+
+template<typename t_loc>
+inline void appendBlocksMins(const t_value* values, const t_array_size begIdx, const t_array_size count, const int blockExp,
+                             t_value* blocksVal, t_loc* blocksLoc, const bool offsetLoc) {
+    if (count == 0)
+        return;
+    const t_array_size endIdx = begIdx + count;
+    const t_array_size begBlock = begIdx >> blockExp;
+    const t_array_size endBlock = (endIdx - 1) >> blockExp;
+    const t_array_size offsetMask = offsetLoc ? ((t_array_size) 1 << blockExp) - 1 : MAX_T_ARRAYSIZE;
+    #pragma omp parallel for
+    for (t_array_size b = begBlock; b <= endBlock; b++) {
+        const t_array_size partBeg = max(begIdx, b << blockExp);
+        const t_array_size partEnd = min(endIdx, (b + 1) << blockExp);
+        const t_value* minPtr = minElement(values + (partBeg - begIdx), values + (partEnd - begIdx));
+        if (partBeg == b << blockExp || *minPtr < blocksVal[b]) {
+            blocksVal[b] = *minPtr;
+            blocksLoc[b] = (begIdx + (minPtr - values)) & offsetMask;
+        }
+    }
+}
+
+#endif //BLOCKMINS_H
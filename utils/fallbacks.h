@@ -0,0 +1,84 @@
+#ifndef FALLBACKS_H
+#define FALLBACKS_H
+
+// Sinks of the secondary structure queries of a hybrid (BbSTx, CBbSTx), passed to its rmqOrDefer.
+// DirectFallback asks the secondary structure at once (a single rmq). DeferredFallbacks, local to one rmqBatch call,
+// records the range a query that cannot be resolved by the sparse table would ask the secondary structure about
+// (and the query gets MAX_T_ARRAYSIZE); the recorded ranges are then sorted by position and answered by one rmqBatch
+// call of the secondary structure, so consecutive secondary queries touch neighbouring parts of it.
+// The hybrid itself keeps no state of a batch, so it can be queried concurrently.
+
+#include <chrono>
+#include <vector>
+#include "../common.h"
+#include "../hybtempl.h"
+#include "kxsort.h"
+
+using namespace std;
+
+struct DirectFallback {
+    template<class Secondary>
+    inline t_array_size query(Secondary* secondaryRMQ, const t_array_size &begIdx, const t_array_size &endIdx) {
+        return secondaryRMQ->rmq(begIdx, endIdx);
+    }
+};
+
+class DeferredFallbacks {
+private:
+    struct Fallback {
+        t_array_size begIdx;
+        t_array_size endIdx;
+        t_array_size queryIdx;
+    };
+
+    struct RadixTraitsFallback {
+        static const int nBytes = sizeof(t_array_size);
+        int kth_byte(const Fallback &x, int k) {
+            return x.begIdx >> (k * 8) & 0xFF;
+        }
+        bool compare(const Fallback &a, const Fallback &b) {
+            return a.begIdx < b.begIdx;
+        }
+    };
+
+    t_array_size lastBegIdx, lastEndIdx;
+    vector<Fallback> fallbacks;
+
+public:
+    // number of secondary queries of the batch and the time of answering them [s] (set by finishBatch)
+    size_t count = 0;
+    double seconds = 0;
+
+    template<class Secondary>
+    inline t_array_size query(Secondary* secondaryRMQ, const t_array_size &begIdx, const t_array_size &endIdx) {
+        lastBegIdx = begIdx;
+        lastEndIdx = endIdx;
+        return MAX_T_ARRAYSIZE;
+    }
+
+    // the query of index queryIdx got MAX_T_ARRAYSIZE
+    inline void add(const t_array_size queryIdx) {
+        fallbacks.push_back({lastBegIdx, lastEndIdx, queryIdx});
+    }
+
+    template<class Secondary>
+    void finishBatch(Secondary* secondaryRMQ, t_array_size *resultLoc) {
+        const auto start = chrono::steady_clock::now();
+        count = fallbacks.size();
+        if (count) {
+            kx::radix_sort(&fallbacks[0], &fallbacks[0] + count, RadixTraitsFallback());
+            vector<t_array_size> ranges(2 * count);
+            vector<t_array_size> results(count);
+            for (size_t i = 0; i < count; i++) {
+                ranges[2 * i] = fallbacks[i].begIdx;
+                ranges[2 * i + 1] = fallbacks[i].endIdx;
+            }
+            secondaryRMQ->rmqBatch(&ranges[0], count, &results[0]);
+            for (size_t i = 0; i < count; i++)
+                resultLoc[fallbacks[i].queryIdx] = results[i];
+        }
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+};
+
+#endif //FALLBACKS_H
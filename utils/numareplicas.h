@@ -0,0 +1,146 @@
+#ifndef NUMAREPLICAS_H
+#define NUMAREPLICAS_H
+
+// Per NUMA node replicas of a read-only RMQ structure. T has to provide a replica constructor T(const T &source, int numaNode)
+// that copies its tables to memory bound to numaNode (the values array stays shared). OpenMP threads are pinned
+// round robin over nodes for the batch and each thread answers its queries with the replica of its node.
+
+#include "../common.h"
+#include "timer.h"
+#include "rmqstats.h"
+
+#include <omp.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// cpus of online NUMA nodes (from /sys/devices/system/node/node*/cpulist); a single node with all cpus if unavailable
+inline vector<pair<int, vector<int>>> getNumaNodesCpus() {
+    vector<pair<int, vector<int>>> nodes;
+    for (int node = 0; node < 64; node++) {
+        ifstream cpuListFile("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+        string range;
+        vector<int> cpus;
+        while (getline(cpuListFile, range, ',')) {
+            const int first = atoi(range.c_str());
+            const size_t dashPos = range.find('-');
+            const int last = dashPos == string::npos ? first : atoi(range.c_str() + dashPos + 1);
+            for (int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        }
+        if (!cpus.empty())
+            nodes.push_back(make_pair(node, cpus));
+    }
+    if (nodes.empty()) {
+        vector<int> cpus(omp_get_num_procs());
+        std::iota(cpus.begin(), cpus.end(), 0);
+        nodes.push_back(make_pair(-1, cpus));
+    }
+    return nodes;
+}
+
+// pins the current thread to cpu while in scope; the affinity it had before is restored on destruction, so pool threads
+// reused by later parallel regions (or by other code) are not left on a single cpu
+class ScopedThreadPin {
+private:
+#ifdef __linux__
+    cpu_set_t previousCpuSet;
+    bool saved;
+#endif
+
+public:
+    ScopedThreadPin(const int cpu) {
+#ifdef __linux__
+        saved = sched_getaffinity(0, sizeof(previousCpuSet), &previousCpuSet) == 0;
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+#endif
+    }
+
+    ~ScopedThreadPin() {
+#ifdef __linux__
+        if (saved)
+            sched_setaffinity(0, sizeof(previousCpuSet), &previousCpuSet);
+#endif
+    }
+};
+
+template<class T> class NumaReplicas {
+private:
+    vector<pair<int, vector<int>>> nodes;
+    vector<T*> replicas;
+    vector<double> nodeQueries, nodeTimes;
+
+public:
+    NumaReplicas(const T &source) {
+        nodes = getNumaNodesCpus();
+        for (size_t i = 0; i < nodes.size(); i++)
+            replicas.push_back(new T(source, nodes[i].first));
+        nodeQueries.assign(nodes.size(), 0);
+        nodeTimes.assign(nodes.size(), 0);
+    }
+
+    ~NumaReplicas() {
+        for (T* replica: replicas)
+            delete replica;
+    }
+
+    size_t nodesCount() {
+        return nodes.size();
+    }
+
+    int nodeId(const size_t nodeIdx) {
+        return nodes[nodeIdx].first;
+    }
+
+    void rmqBatch(const vector<t_array_size> &queries, t_array_size *resultLoc) {
+        const int threadsCount = omp_get_max_threads();
+        vector<double> threadQueries(threadsCount, 0), threadTimes(threadsCount, 0);
+        #pragma omp parallel
+        {
+            const int thread = omp_get_thread_num();
+            const size_t nodeIdx = thread % nodes.size();
+            const vector<int> &cpus = nodes[nodeIdx].second;
+            ScopedThreadPin pin(cpus[(thread / nodes.size()) % cpus.size()]);
+            T* replica = replicas[nodeIdx];
+            ChronoStopWatch threadTimer;
+            threadTimer.startTimer();
+            double queriesCount = 0;
+            #pragma omp for nowait
+            for (int i = 0; i < queries.size(); i = i + 2) {
+                RMQ_STATS_QUERY_BEGIN();
+                resultLoc[i / 2] = replica->rmq(queries[i], queries[i + 1]);
+                RMQ_STATS_QUERY_END();
+                queriesCount++;
+            }
+            threadTimer.stopTimer();
+            threadQueries[thread] = queriesCount;
+            threadTimes[thread] = threadTimer.getElapsedTime();
+        }
+        // node throughput: queries of its threads over the time of the slowest of them
+        vector<double> batchNodeTimes(nodes.size(), 0);
+        for (int thread = 0; thread < threadsCount; thread++) {
+            const size_t nodeIdx = thread % nodes.size();
+            nodeQueries[nodeIdx] += threadQueries[thread];
+            batchNodeTimes[nodeIdx] = max(batchNodeTimes[nodeIdx], threadTimes[thread]);
+        }
+        for (size_t nodeIdx = 0; nodeIdx < nodes.size(); nodeIdx++)
+            nodeTimes[nodeIdx] += batchNodeTimes[nodeIdx];
+    }
+
+    // million queries per second answered by threads of the node (accumulated over rmqBatch calls)
+    double nodeThroughput(const size_t nodeIdx) {
+        return nodeTimes[nodeIdx] > 0 ? nodeQueries[nodeIdx] / nodeTimes[nodeIdx] / 1000000 : 0;
+    }
+
+    size_t memUsageInBytes() {
+        size_t bytes = 0;
+        for (T* replica: replicas)
+            bytes += replica->memUsageInBytes();
+        return bytes;
+    }
+};
+
+#endif /* NUMAREPLICAS_H */
@@ -0,0 +1,95 @@
+#ifndef PARALLEL_RADIX_SORT_H
+#define PARALLEL_RADIX_SORT_H
+
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+namespace prs {
+
+static const int kRadixBits = 8;
+static const int kRadixBin = 1 << kRadixBits;
+static const int kRadixMask = kRadixBin - 1;
+static const int kBufferItems = 8;     // write-combining buffer of a bucket (one cache line of 8-byte items)
+
+// Stable parallel LSD radix sort of items by the unsigned key returned by getKey (only as many 8-bit digits
+// as the maximal key needs are sorted). In each pass threads count the digits of their contiguous parts of the input,
+// prefix sums of the per thread histograms give every thread its own output ranges and the items are scattered
+// through per thread write-combining buffers, so each thread writes whole cache lines of a bucket at once.
+template<class T, class Key, class GetKey>
+void parallel_radix_sort(T* begin, T* end, GetKey getKey) {
+    const size_t size = end - begin;
+    if (size < 2)
+        return;
+    Key maxKey = 0;
+    #pragma omp parallel for reduction(max:maxKey)
+    for (size_t i = 0; i < size; i++)
+        if (getKey(begin[i]) > maxKey)
+            maxKey = getKey(begin[i]);
+    int passes = 0;
+    while (passes < (int) sizeof(Key) && (maxKey >> (passes * kRadixBits)))
+        passes++;
+    if (passes == 0)
+        return;
+
+    T* temp = new T[size];
+    const int threadsCount = omp_get_max_threads();
+    std::vector<size_t> offsets((size_t) threadsCount * kRadixBin);
+    T* src = begin;
+    T* dst = temp;
+    #pragma omp parallel num_threads(threadsCount)
+    {
+        const int thread = omp_get_thread_num();
+        const size_t begIdx = (size * thread) / threadsCount;
+        const size_t endIdx = (size * (thread + 1)) / threadsCount;
+        size_t* threadOffsets = &offsets[(size_t) thread * kRadixBin];
+        T* buffers = new T[kRadixBin * kBufferItems];
+        int buffered[kRadixBin];
+        for (int pass = 0; pass < passes; pass++) {
+            const int shift = pass * kRadixBits;
+            std::fill(threadOffsets, threadOffsets + kRadixBin, 0);
+            for (size_t i = begIdx; i < endIdx; i++)
+                threadOffsets[(getKey(src[i]) >> shift) & kRadixMask]++;
+            #pragma omp barrier
+            #pragma omp single
+            {
+                size_t sum = 0;
+                for (int b = 0; b < kRadixBin; b++)
+                    for (int t = 0; t < threadsCount; t++) {
+                        const size_t count = offsets[(size_t) t * kRadixBin + b];
+                        offsets[(size_t) t * kRadixBin + b] = sum;
+                        sum += count;
+                    }
+            }
+            std::fill(buffered, buffered + kRadixBin, 0);
+            for (size_t i = begIdx; i < endIdx; i++) {
+                const int b = (getKey(src[i]) >> shift) & kRadixMask;
+                T* buffer = buffers + b * kBufferItems;
+                buffer[buffered[b]++] = src[i];
+                if (buffered[b] == kBufferItems) {
+                    memcpy(dst + threadOffsets[b], buffer, kBufferItems * sizeof(T));
+                    threadOffsets[b] += kBufferItems;
+                    buffered[b] = 0;
+                }
+            }
+            for (int b = 0; b < kRadixBin; b++) {
+                memcpy(dst + threadOffsets[b], buffers + b * kBufferItems, buffered[b] * sizeof(T));
+                threadOffsets[b] += buffered[b];
+            }
+            #pragma omp barrier
+            #pragma omp single
+            std::swap(src, dst);
+        }
+        if (src != begin) {
+            #pragma omp for
+            for (size_t i = 0; i < size; i++)
+                begin[i] = src[i];
+        }
+        delete[] buffers;
+    }
+    delete[] temp;
+}
+
+}
+
+#endif /* PARALLEL_RADIX_SORT_H */
@@ -0,0 +1,111 @@
+#include "perfcounters.h"
+
+#include <sstream>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+
+static int openPerfEvent(uint32_t type, uint64_t config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+PerfCounters::PerfCounters(bool enabled) {
+	for (int e = 0; e < PERF_EVENTS_COUNT; e++) {
+		fds[e] = -1;
+		values[e] = 0;
+	}
+#ifdef __linux__
+	if (!enabled)
+		return;
+	fds[cyclesEvent] = openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	fds[instructionsEvent] = openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	fds[llcMissesEvent] = openPerfEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	fds[dtlbMissesEvent] = openPerfEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	fds[branchMissesEvent] = openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+	static bool warned = false;
+	if (!isAvailable() && !warned) {
+		warned = true;
+		fprintf(stderr, "Hardware performance counters unavailable (check /proc/sys/kernel/perf_event_paranoid)\n");
+	}
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+	for (int e = 0; e < PERF_EVENTS_COUNT; e++)
+		if (fds[e] >= 0)
+			close(fds[e]);
+#endif
+}
+
+bool PerfCounters::isAvailable() {
+	for (int e = 0; e < PERF_EVENTS_COUNT; e++)
+		if (fds[e] >= 0)
+			return true;
+	return false;
+}
+
+void PerfCounters::startCounters() {
+#ifdef __linux__
+	for (int e = 0; e < PERF_EVENTS_COUNT; e++)
+		if (fds[e] >= 0) {
+			ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+}
+
+void PerfCounters::stopCounters() {
+#ifdef __linux__
+	for (int e = 0; e < PERF_EVENTS_COUNT; e++)
+		if (fds[e] >= 0) {
+			ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+			uint64_t value = 0;
+			if (read(fds[e], &value, sizeof(value)) == sizeof(value))
+				values[e] += value;
+		}
+#endif
+}
+
+void PerfCounters::resetCounters() {
+	for (int e = 0; e < PERF_EVENTS_COUNT; e++)
+		values[e] = 0;
+}
+
+string PerfCounters::getRatios(double divisor) {
+	stringstream ratios;
+	for (int e = 0; e < PERF_EVENTS_COUNT; e++) {
+		if (e) ratios << "\t";
+		if (fds[e] >= 0)
+			ratios << (values[e] / divisor);
+		else
+			ratios << "-";
+	}
+	return ratios.str();
+}
+
+size_t peakRSSInKB() {
+#ifdef __linux__
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return usage.ru_maxrss;
+#endif
+	return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef _PERFCOUNTERS_H
+#define _PERFCOUNTERS_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+enum perfEvent_enum { cyclesEvent = 0, instructionsEvent = 1, llcMissesEvent = 2, dtlbMissesEvent = 3, branchMissesEvent = 4 };
+
+#define PERF_EVENTS_COUNT 5
+#define PERF_COUNTERS_HEADER "cycles; instructions; LLC misses; dTLB misses; branch misses"
+
+// Hardware counters (perf_event_open, user space only) accumulated over startCounters/stopCounters intervals.
+// Counters are inherited by threads created later, so the object has to be constructed before the first OpenMP
+// parallel region. Events that cannot be opened (no permission, virtual machine, not Linux) are reported as "-".
+class PerfCounters {
+
+private:
+	int fds[PERF_EVENTS_COUNT];
+	uint64_t values[PERF_EVENTS_COUNT];
+public:
+	PerfCounters(bool enabled = true);
+	~PerfCounters();
+	bool isAvailable();
+	void startCounters();
+	void stopCounters();
+	void resetCounters();
+	// tab separated counter values divided by divisor (e.g. number of queries)
+	string getRatios(double divisor);
+};
+
+// peak resident set size of the process so far [KB] (0 if unknown)
+size_t peakRSSInKB();
+
+#endif /* _PERFCOUNTERS_H */
@@ -0,0 +1,157 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+// Small concurrent cache of query results keyed by the exact range (begIdx, endIdx), compiled in only with -DRESULT_CACHE.
+// The cache is split into shards, the thread number in the current OpenMP team selects the shard (modulo shards count).
+// A query holds its shard from lookup to insert (acquireShard/releaseShard, a try-lock that never waits). With a single
+// team of at most shards count threads (rmqBatch) each thread always gets its own shard; a thread of another team
+// (or a non-OpenMP thread, which is thread 0) that finds the shard held answers that query without the cache.
+// A shard is a set associative table (SET_WAYS entries per set, a set per cache line) with CLOCK eviction within a set.
+
+#include <atomic>
+#include "../common.h"
+
+#include <omp.h>
+
+class RMQResultCache {
+    struct CacheSet;
+
+public:
+    static const int SET_WAYS = 4;
+
+    struct alignas(64) Shard {
+        CacheSet* sets;
+        uint64_t hits = 0, misses = 0;
+        atomic_flag busy = ATOMIC_FLAG_INIT;
+    };
+
+    // entries per shard of the caches created afterwards (rounded up to a power of 2, at least SET_WAYS)
+    static t_array_size &defaultShardCapacity() {
+        static t_array_size capacity = 1 << 14;
+        return capacity;
+    }
+
+    RMQResultCache(int shardsCount = 0, t_array_size shardCapacity = defaultShardCapacity()) {
+        this->shardsCount = shardsCount > 0 ? shardsCount : max((int) thread::hardware_concurrency(), omp_get_max_threads());
+        setsCount = 1;
+        while (setsCount * SET_WAYS < shardCapacity)
+            setsCount <<= 1;
+        // new does not honour alignas(64) before C++17
+        shards = (Shard*) allocAligned(this->shardsCount * sizeof(Shard));
+        for (int s = 0; s < this->shardsCount; s++) {
+            new (shards + s) Shard();
+            shards[s].sets = (CacheSet*) allocAligned(setsCount * sizeof(CacheSet));
+        }
+        clear();
+    }
+
+    virtual ~RMQResultCache() {
+        for (int s = 0; s < shardsCount; s++) {
+            free(shards[s].sets);
+            shards[s].~Shard();
+        }
+        free(shards);
+    }
+
+    // returns 0 if the shard of the calling thread is held by another thread
+    inline Shard* acquireShard() {
+        const int thread = omp_get_thread_num();
+        Shard* shard = shards + (thread < shardsCount ? thread : thread % shardsCount);
+        return shard->busy.test_and_set(memory_order_acquire) ? 0 : shard;
+    }
+
+    inline void releaseShard(Shard* shard) {
+        shard->busy.clear(memory_order_release);
+    }
+
+    inline bool lookup(Shard* shard, const t_array_size begIdx, const t_array_size endIdx, t_array_size &result) {
+        const uint64_t key = ((uint64_t) begIdx << 32) | endIdx;
+        CacheSet &set = shard->sets[getSet(key)];
+        for (int w = 0; w < SET_WAYS; w++)
+            if (set.keys[w] == key) {
+                result = set.results[w];
+                set.referenced |= 1 << w;
+                shard->hits++;
+                return true;
+            }
+        shard->misses++;
+        return false;
+    }
+
+    inline void insert(Shard* shard, const t_array_size begIdx, const t_array_size endIdx, const t_array_size result) {
+        const uint64_t key = ((uint64_t) begIdx << 32) | endIdx;
+        CacheSet &set = shard->sets[getSet(key)];
+        // CLOCK: clear reference bits until the hand points to an entry that was not used since the last sweep
+        while (set.referenced & (1 << set.hand)) {
+            set.referenced &= ~(1 << set.hand);
+            set.hand = (set.hand + 1) % SET_WAYS;
+        }
+        set.keys[set.hand] = key;
+        set.results[set.hand] = result;
+        set.hand = (set.hand + 1) % SET_WAYS;
+    }
+
+    uint64_t hits() {
+        uint64_t sum = 0;
+        for (int s = 0; s < shardsCount; s++)
+            sum += shards[s].hits;
+        return sum;
+    }
+
+    uint64_t misses() {
+        uint64_t sum = 0;
+        for (int s = 0; s < shardsCount; s++)
+            sum += shards[s].misses;
+        return sum;
+    }
+
+    double hitRate() {
+        const uint64_t lookups = hits() + misses();
+        return lookups ? (double) hits() / lookups : 0;
+    }
+
+    void resetStats() {
+        for (int s = 0; s < shardsCount; s++)
+            shards[s].hits = shards[s].misses = 0;
+    }
+
+    void clear() {
+        for (int s = 0; s < shardsCount; s++)
+            for (t_array_size i = 0; i < setsCount; i++) {
+                memset(shards[s].sets[i].keys, 0xFF, sizeof(shards[s].sets[i].keys));
+                shards[s].sets[i].referenced = 0;
+                shards[s].sets[i].hand = 0;
+            }
+        resetStats();
+    }
+
+    size_t memUsageInBytes() {
+        return (size_t) shardsCount * (sizeof(Shard) + setsCount * sizeof(CacheSet));
+    }
+
+private:
+    // a set fits in one cache line; empty entries have all key bits set ((MAX_T_ARRAYSIZE, MAX_T_ARRAYSIZE) is never a query)
+    struct alignas(64) CacheSet {
+        uint64_t keys[SET_WAYS];
+        t_array_size results[SET_WAYS];
+        uint8_t referenced;     // bit w is the CLOCK reference bit of way w
+        uint8_t hand;
+    };
+
+    int shardsCount;
+    t_array_size setsCount;
+    Shard* shards;
+
+    inline t_array_size getSet(const uint64_t key) {
+        return (t_array_size) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (setsCount - 1);
+    }
+
+    static void* allocAligned(const size_t bytes) {
+        void* ptr;
+        if (posix_memalign(&ptr, 64, bytes))
+            throw bad_alloc();
+        return ptr;
+    }
+};
+
+#endif /* RESULTCACHE_H */
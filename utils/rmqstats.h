@@ -0,0 +1,147 @@
+#ifndef RMQSTATS_H
+#define RMQSTATS_H
+
+// Per query path counters and rdtsc latency histograms of the BbST family, compiled in only with -DRMQ_STATS.
+// Each query starts on the sparse table path and is moved to the most expensive path it takes
+// (stPath < miniPath < scanPath < secondaryPath).
+
+#include "../common.h"
+#include "../hybtempl.h"
+
+enum rmqPath_enum { stPath = 0, miniPath = 1, scanPath = 2, secondaryPath = 3 };
+
+#ifdef RMQ_STATS
+
+#include <x86intrin.h>
+#include <atomic>
+
+#define RMQ_STATS_PATHS 4
+#define RMQ_STATS_BUCKETS 48
+#define RMQ_STATS_SLOTS 256     // threads recording between resets (OpenMP threads, query engine workers, clients)
+
+inline int &rmqStatsCurrentPath() {
+    static thread_local int path = stPath;
+    return path;
+}
+
+class RMQStats {
+public:
+    struct alignas(64) ThreadStats {
+        uint64_t count[RMQ_STATS_PATHS] = {};
+        uint64_t cycles[RMQ_STATS_PATHS] = {};
+        uint64_t histogram[RMQ_STATS_PATHS][RMQ_STATS_BUCKETS] = {};    // bucket b counts latencies in [2^b, 2^(b+1)) cycles
+    };
+
+    static RMQStats& instance() {
+        static RMQStats stats;
+        return stats;
+    }
+
+    // has to be called while no queries are answered
+    void reset() {
+        threadStats.assign(RMQ_STATS_SLOTS, ThreadStats());
+        nextSlot = 0;
+        unrecordedQueries = 0;
+        generation++;
+    }
+
+    inline void record(int path, uint64_t cycles) {
+        if (threadStats.empty())
+            return;
+        // each thread takes its own slot at its first query after a reset (omp_get_thread_num() is 0 in every
+        // thread outside OpenMP, e.g. in query engine workers)
+        static thread_local unsigned slotGeneration = 0;
+        static thread_local int slot;
+        if (slotGeneration != generation) {
+            slotGeneration = generation;
+            slot = nextSlot++;
+        }
+        if (slot >= RMQ_STATS_SLOTS) {
+            unrecordedQueries++;
+            return;
+        }
+        ThreadStats &ts = threadStats[slot];
+        ts.count[path]++;
+        ts.cycles[path] += cycles;
+        ts.histogram[path][cycles ? std::min(63 - __builtin_clzll(cycles), RMQ_STATS_BUCKETS - 1) : 0]++;
+    }
+
+    ThreadStats total() {
+        ThreadStats sum;
+        for(const ThreadStats &ts: threadStats)
+            for(int p = 0; p < RMQ_STATS_PATHS; p++) {
+                sum.count[p] += ts.count[p];
+                sum.cycles[p] += ts.cycles[p];
+                for(int b = 0; b < RMQ_STATS_BUCKETS; b++)
+                    sum.histogram[p][b] += ts.histogram[p][b];
+            }
+        return sum;
+    }
+
+    // appends one JSON object (a line) with params and the per path statistics to fileName
+    void dumpJSON(const string &fileName, const string &rmqName, const vector<pair<string, double>> &params) {
+        static const char* pathNames[RMQ_STATS_PATHS] = { "st", "mini", "scan", "secondary" };
+        const ThreadStats sum = total();
+        uint64_t queries = 0;
+        for(int p = 0; p < RMQ_STATS_PATHS; p++)
+            queries += sum.count[p];
+        fstream fout(fileName, ios::out | ios::binary | ios::app);
+        fout << "{\"structure\": \"" << rmqName << "\"";
+        for(const pair<string, double> &param: params)
+            fout << ", \"" << param.first << "\": " << param.second;
+        fout << ", \"queries\": " << queries;
+        if (unrecordedQueries)
+            fout << ", \"unrecorded_queries\": " << unrecordedQueries;
+        fout << ", \"paths\": {";
+        for(int p = 0; p < RMQ_STATS_PATHS; p++) {
+            int lastBucket = RMQ_STATS_BUCKETS - 1;
+            while (lastBucket > 0 && !sum.histogram[p][lastBucket])
+                lastBucket--;
+            fout << (p ? ", " : "") << "\"" << pathNames[p] << "\": {\"count\": " << sum.count[p]
+                 << ", \"fraction\": " << (queries ? (double) sum.count[p] / queries : 0)
+                 << ", \"avg_cycles\": " << (sum.count[p] ? (double) sum.cycles[p] / sum.count[p] : 0)
+                 << ", \"log2_cycles_histogram\": [";
+            for(int b = 0; b <= lastBucket; b++)
+                fout << (b ? ", " : "") << sum.histogram[p][b];
+            fout << "]}";
+        }
+        fout << "}}" << std::endl;
+    }
+
+private:
+    vector<ThreadStats> threadStats;
+    std::atomic<unsigned> generation{0};
+    std::atomic<int> nextSlot{0};
+    std::atomic<uint64_t> unrecordedQueries{0};    // of threads beyond RMQ_STATS_SLOTS
+};
+
+// counts calls of the secondary structure of hybrids as the secondary path
+class RMQStatsProbe: public RMQAPI {
+private:
+    RMQAPI* secondaryRMQ;
+public:
+    RMQStatsProbe(RMQAPI* secondaryRMQ): secondaryRMQ(secondaryRMQ) {}
+
+    t_array_size rmq(const t_array_size &begIdx, const t_array_size &endIdx) {
+        rmqStatsCurrentPath() = secondaryPath;
+        return secondaryRMQ->rmq(begIdx, endIdx);
+    }
+
+    size_t memUsageInBytes() {
+        return secondaryRMQ->memUsageInBytes();
+    }
+};
+
+#define RMQ_STATS_PATH(path) { int &rmqStatsPath = rmqStatsCurrentPath(); if (rmqStatsPath < (path)) rmqStatsPath = (path); }
+#define RMQ_STATS_QUERY_BEGIN() rmqStatsCurrentPath() = stPath; const uint64_t rmqStatsStart = __rdtsc();
+#define RMQ_STATS_QUERY_END() RMQStats::instance().record(rmqStatsCurrentPath(), __rdtsc() - rmqStatsStart);
+
+#else
+
+#define RMQ_STATS_PATH(path)
+#define RMQ_STATS_QUERY_BEGIN()
+#define RMQ_STATS_QUERY_END()
+
+#endif
+
+#endif /* RMQSTATS_H */
@@ -0,0 +1,124 @@
+#ifndef TABLEALLOC_H
+#define TABLEALLOC_H
+
+// Allocation policy of the BbST family tables (blocks sparse table, miniblocks, masks, hierarchy levels).
+// Tables must be released with freeTable. Only tables of at least TABLE_MAP_THRESHOLD bytes are mapped (with the policy
+// below); smaller ones come from posix_memalign, as a huge page mapping per table would mostly stay unused.
+//  d - default (malloc)
+//  t - transparent huge pages (2MB aligned mmap + madvise(MADV_HUGEPAGE))
+//  h - hugetlbfs pages (mmap MAP_HUGETLB, falls back to t if no huge pages are reserved)
+//  i - NUMA interleave over all online nodes (mbind(MPOL_INTERLEAVE) + transparent huge pages)
+// Mapped tables of NUMA replicas are bound to their node (mbind(MPOL_BIND)); smaller replica tables are not bound,
+// they are read from the caches of the node most of the time.
+
+#include "../common.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum allocPolicy_enum { defaultAlloc = 'd', thpAlloc = 't', hugetlbAlloc = 'h', interleaveAlloc = 'i' };
+
+#define ALLOC_POLICY_USAGE "-a allocation policy of tables: d-default; t-transparent huge pages; h-MAP_HUGETLB; i-NUMA interleave\n"
+
+const size_t TABLE_HUGE_PAGE_SIZE = 1 << 21;
+const size_t TABLE_MAP_THRESHOLD = TABLE_HUGE_PAGE_SIZE;
+const size_t TABLE_HEADER_SIZE = 64;    // keeps the table cache line aligned
+
+inline allocPolicy_enum &tableAllocPolicy() {
+    static allocPolicy_enum policy = defaultAlloc;
+    return policy;
+}
+
+inline bool isAllocPolicy(const char policy) {
+    return policy == defaultAlloc || policy == thpAlloc || policy == hugetlbAlloc || policy == interleaveAlloc;
+}
+
+#ifdef __linux__
+inline void* mapHugeTable(const size_t bytes, const allocPolicy_enum policy, size_t &mappedBytes, const int numaNode) {
+    mappedBytes = (bytes + TABLE_HUGE_PAGE_SIZE - 1) & ~(TABLE_HUGE_PAGE_SIZE - 1);
+    if (policy == hugetlbAlloc) {
+        void* ptr = mmap(0, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED)
+            return ptr;
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            fprintf(stderr, "MAP_HUGETLB allocation failed (check /proc/sys/vm/nr_hugepages), using transparent huge pages\n");
+        }
+    }
+    // over-map by one huge page and trim to get a 2MB aligned region
+    char* raw = (char*) mmap(0, mappedBytes + TABLE_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return 0;
+    char* aligned = (char*) (((uintptr_t) raw + TABLE_HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (TABLE_HUGE_PAGE_SIZE - 1));
+    if (aligned > raw)
+        munmap(raw, aligned - raw);
+    munmap(aligned + mappedBytes, raw + TABLE_HUGE_PAGE_SIZE - aligned);
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, mappedBytes, MADV_HUGEPAGE);
+#endif
+    if (policy == interleaveAlloc || numaNode >= 0) {
+        // MPOL_BIND = 2, MPOL_INTERLEAVE = 3; nodes from /sys/devices/system/node/online (e.g. "0-1,3")
+        unsigned long nodeMask = 0;
+        if (numaNode >= 0)
+            nodeMask = 1UL << numaNode;
+        else {
+            ifstream nodesFile("/sys/devices/system/node/online");
+            string range;
+            while (getline(nodesFile, range, ',')) {
+                const int first = atoi(range.c_str());
+                const size_t dashPos = range.find('-');
+                const int last = dashPos == string::npos ? first : atoi(range.c_str() + dashPos + 1);
+                for (int node = first; node <= last && node < 64; node++)
+                    nodeMask |= 1UL << node;
+            }
+        }
+        if (!nodeMask || syscall(SYS_mbind, aligned, mappedBytes, numaNode >= 0 ? 2 : 3, &nodeMask, 64, 0) != 0) {
+            static bool warned = false;
+            if (!warned) {
+                warned = true;
+                fprintf(stderr, "NUMA placement (mbind) unavailable, using transparent huge pages\n");
+            }
+        }
+    }
+    return aligned;
+}
+#endif
+
+// header before the table: mapped size (0 for posix_memalign)
+template<typename T> T* allocTable(const size_t count, const int numaNode = -1) {
+    const size_t bytes = TABLE_HEADER_SIZE + count * sizeof(T);
+    const allocPolicy_enum policy = tableAllocPolicy();
+    char* ptr = 0;
+    size_t mappedBytes = 0;
+#ifdef __linux__
+    if ((numaNode >= 0 || policy != defaultAlloc) && bytes >= TABLE_MAP_THRESHOLD)
+        ptr = (char*) mapHugeTable(bytes, policy, mappedBytes, numaNode);
+#endif
+    if (!ptr) {
+        mappedBytes = 0;
+        if (posix_memalign((void**) &ptr, TABLE_HEADER_SIZE, bytes) != 0)
+            throw std::bad_alloc();
+    }
+    *(size_t*) ptr = mappedBytes;
+    return (T*) (ptr + TABLE_HEADER_SIZE);
+}
+
+template<typename T> void freeTable(T* table) {
+    if (!table)
+        return;
+    char* ptr = (char*) table - TABLE_HEADER_SIZE;
+    const size_t mappedBytes = *(size_t*) ptr;
+#ifdef __linux__
+    if (mappedBytes) {
+        munmap(ptr, mappedBytes);
+        return;
+    }
+#endif
+    free(ptr);
+}
+
+#endif /* TABLEALLOC_H */
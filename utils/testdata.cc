@@ -40,26 +40,239 @@ void getPseudoMonotonicValues(vector<t_value> &data, t_value delta, bool decreas
         }
 }
 
+void writeRandomValuesFile(const string &fileName, const t_array_size n, const t_value modulo) {
+    fstream fout(fileName, ios::out | ios::binary | ios::trunc);
+    if (!fout) {
+        fprintf(stderr, "Cannot create values file %s\n", fileName.c_str());
+        exit(EXIT_FAILURE);
+    }
+    randgenerator.seed(randgenerator.default_seed);
+    vector<t_value> chunk(1 << 20);
+    for(t_array_size i = 0; i < n; i += chunk.size()) {
+        const t_array_size count = min((t_array_size) chunk.size(), n - i);
+        for(t_array_size j = 0; j < count; j++) {
+            chunk[j] = randgenerator();
+            if (modulo > 0)
+                chunk[j] %= modulo;
+        }
+        fout.write((char*) &chunk[0], count * sizeof(t_value));
+    }
+}
+
+bool readValuesFile(vector<t_value> &data, const string &fileName) {
+    fstream fin(fileName, ios::in | ios::binary);
+    if (!fin)
+        return false;
+    fin.seekg(0, ios::end);
+    data.resize(fin.tellg() / sizeof(t_value));
+    fin.seekg(0, ios::beg);
+    fin.read((char*) &data[0], data.size() * sizeof(t_value));
+    return (bool) fin;
+}
+
+// query with one end at randA and the other drawn uniformly from [randA - max_range_size, randA + max_range_size]
+inline pair<t_array_size, t_array_size> getRangeAround(const t_array_size randA, const t_array_size array_size, const t_array_size max_range_size) {
+    t_array_size maxB = randA + max_range_size;
+    if (maxB >= array_size) {
+        maxB = array_size - 1;
+    }
+    t_array_size minB = 0;
+    if (max_range_size < randA) {
+        minB = randA - max_range_size;
+    }
+    const t_array_size randB = minB + randgenerator() % (maxB - minB + 1);
+    if (randA < randB)
+        return make_pair(randA, randB);
+    else
+        return make_pair(randB, randA);
+}
+
 void getRandomRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size) {
     randgenerator.seed(randgenerator.default_seed);
     for(long long int i = 0; i < queries.size(); i++) {
         const t_array_size randA = randgenerator() % (array_size);
-        t_array_size maxB = randA + max_range_size;
-        if (maxB >= array_size) {
-            maxB = array_size - 1;
+        queries[i] = getRangeAround(randA, array_size, max_range_size);
+    }
+}
+
+// Zipf distributed ranks 1..n (P(k) ~ k^-s) by rejection-inversion sampling (Hormann, Derflinger 1996), O(1) memory
+class ZipfGenerator {
+private:
+    const double s;
+    const double n;
+    double hIntegralX1, hIntegralN, sParam;
+
+    static double helper1(const double x) { return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x)); }
+    static double helper2(const double x) { return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x)); }
+    double h(const double x) { return exp(-s * log(x)); }
+    double hIntegral(const double x) { const double logX = log(x); return helper2((1 - s) * logX) * logX; }
+    double hIntegralInverse(const double x) { double t = x * (1 - s); if (t < -1) t = -1; return exp(helper1(t) * x); }
+
+public:
+    ZipfGenerator(const t_array_size n, const double s): s(s), n(n) {
+        hIntegralX1 = hIntegral(1.5) - 1;
+        hIntegralN = hIntegral(n + 0.5);
+        sParam = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+    }
+
+    t_array_size next() {
+        while (true) {
+            const double u = hIntegralN + (randgenerator() / 4294967296.0) * (hIntegralX1 - hIntegralN);
+            const double x = hIntegralInverse(u);
+            double k = floor(x + 0.5);
+            if (k < 1) k = 1;
+            else if (k > n) k = n;
+            if (k - x <= sParam || u >= hIntegral(k + 0.5) - h(k))
+                return (t_array_size) k;
         }
-        t_array_size minB = 0;
-        if (max_range_size < randA) {
-            minB = randA - max_range_size;
+    }
+};
+
+void getZipfRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size, const double s) {
+    randgenerator.seed(randgenerator.default_seed);
+    ZipfGenerator zipf(array_size, s);
+    for(long long int i = 0; i < queries.size(); i++) {
+        // hot ranks are scattered over the array
+        const t_array_size randA = ((uint64_t) (zipf.next() - 1) * 2654435761ULL) % array_size;
+        queries[i] = getRangeAround(randA, array_size, max_range_size);
+    }
+}
+
+void getHotspotRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size, const double hotFraction) {
+    const t_array_size hotCount = 1024;
+    vector<pair<t_array_size, t_array_size>> hotQueries(hotCount);
+    getRandomRangeQueries(hotQueries, array_size, max_range_size);
+    for(long long int i = 0; i < queries.size(); i++) {
+        if (randgenerator() / 4294967296.0 < hotFraction)
+            queries[i] = hotQueries[randgenerator() % hotCount];
+        else {
+            const t_array_size randA = randgenerator() % (array_size);
+            queries[i] = getRangeAround(randA, array_size, max_range_size);
         }
-        const t_array_size randB = minB + randgenerator() % (maxB - minB + 1);
-        if (randA < randB) {
-            queries[i].first =  randA;
-            queries[i].second = randB;
-        } else {
-            queries[i].first =  randB;
-            queries[i].second = randA;
+    }
+}
+
+void getRepeatedRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size, const t_array_size distinctCount) {
+    vector<pair<t_array_size, t_array_size>> distinctQueries(distinctCount);
+    getRandomRangeQueries(distinctQueries, array_size, max_range_size);
+    for(long long int i = 0; i < queries.size(); i++)
+        queries[i] = distinctQueries[randgenerator() % distinctCount];
+}
+
+void getLogUniformRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size) {
+    randgenerator.seed(randgenerator.default_seed);
+    const t_array_size maxLength = max_range_size < array_size ? max_range_size : array_size - 1;
+    const double logMaxLength = log(maxLength + 1.0);
+    for(long long int i = 0; i < queries.size(); i++) {
+        t_array_size length = (t_array_size) exp(randgenerator() / 4294967296.0 * logMaxLength) - 1;
+        if (length > maxLength) length = maxLength;
+        const t_array_size randA = randgenerator() % (array_size - length);
+        queries[i] = make_pair(randA, randA + length);
+    }
+}
+
+void getSortedRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size) {
+    getRandomRangeQueries(queries, array_size, max_range_size);
+    std::sort(queries.begin(), queries.end());
+}
+
+void getClusteredRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size, const t_array_size clusterSize) {
+    randgenerator.seed(randgenerator.default_seed);
+    const t_array_size windowSize = max_range_size < array_size ? max_range_size : array_size;
+    for(long long int i = 0; i < queries.size(); i += clusterSize) {
+        // all queries of a cluster start in the same window of the array
+        const t_array_size windowBeg = randgenerator() % (array_size - windowSize + 1);
+        for(long long int j = i; j < queries.size() && j < i + clusterSize; j++) {
+            const t_array_size randA = windowBeg + randgenerator() % windowSize;
+            queries[j] = getRangeAround(randA, array_size, max_range_size);
+        }
+    }
+}
+
+void getAdversarialRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const vector<t_value> &data, const t_array_size max_range_size, const t_array_size blockSize) {
+    randgenerator.seed(randgenerator.default_seed);
+    const t_array_size array_size = data.size();
+    const t_array_size blocksCount = (array_size + blockSize - 1) / blockSize;
+    vector<t_array_size> blocksMinLoc(blocksCount);
+    for(t_array_size b = 0; b < blocksCount; b++) {
+        const t_value* blockBeg = &data[0] + (t_array_size_2x) b * blockSize;
+        const t_value* blockEnd = &data[0] + min((t_array_size_2x) array_size, (t_array_size_2x) (b + 1) * blockSize);
+        blocksMinLoc[b] = std::min_element(blockBeg, blockEnd) - &data[0];
+    }
+    for(long long int i = 0; i < queries.size(); i++) {
+        // query begins just after the minimum of its first block and ends just before the minimum of its last block
+        // (if possible), so both edge block minima are outside of the query
+        t_array_size begIdx = blocksMinLoc[randgenerator() % blocksCount] + 1;
+        if (begIdx == array_size)
+            begIdx--;
+        t_array_size endIdx = begIdx + randgenerator() % (max_range_size < array_size - begIdx ? max_range_size : array_size - begIdx);
+        const t_array_size endBlockMinLoc = blocksMinLoc[endIdx / blockSize];
+        if (endBlockMinLoc > begIdx && endBlockMinLoc <= endIdx)
+            endIdx = endBlockMinLoc - 1;
+        queries[i] = make_pair(begIdx, endIdx);
+    }
+}
+
+void readRangeQueriesTrace(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const string &fileName) {
+    fstream fin(fileName, ios::in | ios::binary);
+    if (!fin) {
+        fprintf(stderr, "Cannot open queries trace %s\n", fileName.c_str());
+        exit(EXIT_FAILURE);
+    }
+    fin.seekg(0, ios::end);
+    const size_t queriesCount = fin.tellg() / (2 * sizeof(t_array_size));
+    fin.seekg(0, ios::beg);
+    if (queriesCount == 0) {
+        fprintf(stderr, "Empty queries trace %s\n", fileName.c_str());
+        exit(EXIT_FAILURE);
+    }
+    vector<t_array_size> trace(2 * queriesCount);
+    fin.read((char*) &trace[0], trace.size() * sizeof(t_array_size));
+    queries.resize(queriesCount);
+    for(size_t i = 0; i < queriesCount; i++) {
+        if (trace[2 * i] > trace[2 * i + 1] || trace[2 * i + 1] >= array_size) {
+            fprintf(stderr, "Invalid query (%u, %u) at position %zu of queries trace %s\n", trace[2 * i], trace[2 * i + 1], i, fileName.c_str());
+            exit(EXIT_FAILURE);
         }
+        queries[i] = make_pair(trace[2 * i], trace[2 * i + 1]);
+    }
+}
+
+void getWorkloadRangeQueries(const string &workload, vector<pair<t_array_size, t_array_size>> &queries, const vector<t_value> &data,
+        const t_array_size max_range_size, const t_array_size blockSize) {
+    if (workload.substr(0, workload.find(':')) == "adversarial")
+        getAdversarialRangeQueries(queries, data, max_range_size, blockSize);
+    else
+        getWorkloadRangeQueries(workload, queries, (t_array_size) data.size(), max_range_size);
+}
+
+void getWorkloadRangeQueries(const string &workload, vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size,
+        const t_array_size max_range_size) {
+    const size_t colonPos = workload.find(':');
+    const string name = workload.substr(0, colonPos);
+    const string param = colonPos == string::npos ? "" : workload.substr(colonPos + 1);
+    if (name == "uniform")
+        getRandomRangeQueries(queries, array_size, max_range_size);
+    else if (name == "zipf")
+        getZipfRangeQueries(queries, array_size, max_range_size, param.empty() ? 0.99 : atof(param.c_str()));
+    else if (name == "hotspot")
+        getHotspotRangeQueries(queries, array_size, max_range_size, param.empty() ? 0.9 : atof(param.c_str()));
+    else if (name == "repeated")
+        getRepeatedRangeQueries(queries, array_size, max_range_size, param.empty() ? 65536 : max(1, atoi(param.c_str())));
+    else if (name == "loguniform")
+        getLogUniformRangeQueries(queries, array_size, max_range_size);
+    else if (name == "sorted")
+        getSortedRangeQueries(queries, array_size, max_range_size);
+    else if (name == "clustered")
+        getClusteredRangeQueries(queries, array_size, max_range_size, param.empty() ? 64 : max(1, atoi(param.c_str())));
+    else if (name == "trace")
+        readRangeQueriesTrace(queries, array_size, param);
+    else if (name == "adversarial") {
+        fprintf(stderr, "Workload adversarial requires the values in memory\n");
+        exit(EXIT_FAILURE);
+    } else {
+        fprintf(stderr, "Unknown workload %s\n%s", workload.c_str(), WORKLOAD_USAGE);
+        exit(EXIT_FAILURE);
     }
 }
 
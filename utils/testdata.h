@@ -10,7 +10,31 @@ void getRandomValues(vector<t_value> &data, const t_value modulo = 0);
 void getPermutationOfRange(vector<t_value> &data);
 void getPseudoMonotonicValues(vector<t_value> &data, t_value delta, bool decreasing);
 
+// values file: binary t_value array (e.g. for BbSTcon::rmqBatchFromFile); writes the values of getRandomValues
+// in chunks (memory independent of n) and reads the whole file (n = file size / sizeof(t_value))
+void writeRandomValuesFile(const string &fileName, const t_array_size n, const t_value modulo = 0);
+bool readValuesFile(vector<t_value> &data, const string &fileName);
+
 void getRandomRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size);
+void getZipfRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size, const double s);
+void getHotspotRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size, const double hotFraction);
+void getRepeatedRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size, const t_array_size distinctCount);
+void getLogUniformRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size);
+void getSortedRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size);
+void getClusteredRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const t_array_size max_range_size, const t_array_size clusterSize);
+void getAdversarialRangeQueries(vector<pair<t_array_size, t_array_size>> &queries, const vector<t_value> &data, const t_array_size max_range_size, const t_array_size blockSize);
+void readRangeQueriesTrace(vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size, const string &fileName);
+
+// workload names accepted by getWorkloadRangeQueries (-w option of benchmarks)
+#define WORKLOAD_USAGE "-w workload: uniform (default), zipf[:s], hotspot[:hot fraction], repeated[:distinct queries], loguniform, sorted, clustered[:cluster size], adversarial, trace:file\n"
+
+// fills queries according to the workload name (with optional ":parameter"); blockSize is used by the adversarial workload
+// and the trace workload resizes queries to the number of queries in the trace file (pairs of t_array_size: begin, end)
+void getWorkloadRangeQueries(const string &workload, vector<pair<t_array_size, t_array_size>> &queries, const vector<t_value> &data,
+        const t_array_size max_range_size, const t_array_size blockSize);
+// the same for an array of array_size values not kept in memory (all workloads but adversarial)
+void getWorkloadRangeQueries(const string &workload, vector<pair<t_array_size, t_array_size>> &queries, const t_array_size array_size,
+        const t_array_size max_range_size);
 
 vector<t_array_size> flattenQueries(const vector<pair<t_array_size, t_array_size>> &queriesPairs, const t_array_size queries_count);
 
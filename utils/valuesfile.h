@@ -0,0 +1,133 @@
+#ifndef VALUESFILE_H
+#define VALUESFILE_H
+
+// Sequential reader of a binary file of t_value (the values array on disk) in chunks of a fixed size.
+// The file is opened with O_DIRECT (chunks land in an aligned buffer bypassing the page cache) when the file system
+// supports it, otherwise it is read through the page cache with POSIX_FADV_SEQUENTIAL readahead.
+// The next chunk is read by a helper thread while the current one is consumed (two chunk buffers),
+// so the memory is 2 * chunkBytes whatever the size of the file.
+
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "../common.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+class ValuesFileReader {
+public:
+    // O_DIRECT offset, size and buffer alignment (passed by value to std::max/min, it has no out-of-class definition)
+    static const size_t ALIGNMENT = 4096;
+
+    ValuesFileReader(const string &fileName, size_t chunkBytes = 1 << 24, bool direct = true): fileName(fileName), direct(direct) {
+        this->chunkBytes = max((chunkBytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1), (size_t) ALIGNMENT);
+        openFile();
+        struct stat fileStat;
+        if (fd >= 0 && fstat(fd, &fileStat) == 0)
+            fileBytes = fileStat.st_size;
+        for (int b = 0; b < 2; b++)
+            if (posix_memalign((void**) &buffers[b], ALIGNMENT, this->chunkBytes))
+                buffers[b] = 0;
+    }
+
+    ~ValuesFileReader() {
+        if (fd >= 0)
+            close(fd);
+        free(buffers[0]);
+        free(buffers[1]);
+    }
+
+    bool isOpen() { return fd >= 0 && buffers[0] && buffers[1]; }
+    bool isDirect() { return direct; }
+    t_array_size size() { return fileBytes / sizeof(t_value); }
+    size_t memUsageInBytes() { return 2 * chunkBytes; }
+
+    // bytes read from the file and time spent in reads [s] (summed over all stream calls)
+    size_t readBytes = 0;
+    double readSeconds = 0;
+
+    // reads values [begIdx, endIdx) once, in order, calling consume(const t_value* values, t_array_size begIdx, t_array_size count)
+    // for each chunk; returns false on a read error
+    template<class Consumer>
+    bool stream(const t_array_size begIdx, const t_array_size endIdx, Consumer consume) {
+        const size_t begByte = (size_t) begIdx * sizeof(t_value);
+        const size_t endByte = min((size_t) endIdx * sizeof(t_value), fileBytes);
+        size_t offset = begByte & ~(ALIGNMENT - 1);
+        if (offset >= endByte)
+            return true;
+        int cur = 0;
+        ssize_t got = readChunk(buffers[cur], offset, chunkToRead(offset, endByte));
+        while (got > 0) {
+            // chunks are full (aligned) up to the end of the file, so the next offset is known before consuming
+            const size_t nextOffset = offset + got;
+            ssize_t nextGot = 0;
+            thread reader;
+            if (nextOffset < endByte)
+                reader = thread([&]() { nextGot = readChunk(buffers[1 - cur], nextOffset, chunkToRead(nextOffset, endByte)); });
+            const size_t firstByte = max(offset, begByte);
+            const size_t lastByte = min(offset + got, endByte);
+            if (lastByte > firstByte)
+                consume((const t_value*) (buffers[cur] + firstByte - offset), (t_array_size) (firstByte / sizeof(t_value)),
+                        (t_array_size) ((lastByte - firstByte) / sizeof(t_value)));
+            if (nextOffset >= endByte)
+                return true;
+            reader.join();
+            offset = nextOffset;
+            got = nextGot;
+            cur = 1 - cur;
+        }
+        return false;
+    }
+
+private:
+    string fileName;
+    bool direct;
+    int fd = -1;
+    size_t fileBytes = 0;
+    size_t chunkBytes;
+    char* buffers[2] = {0, 0};
+
+    void openFile() {
+        if (direct)
+            fd = open(fileName.c_str(), O_RDONLY | O_DIRECT);
+        if (fd < 0) {
+            direct = false;
+            fd = open(fileName.c_str(), O_RDONLY);
+            if (fd >= 0)
+                posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+    }
+
+    size_t chunkToRead(const size_t offset, const size_t endByte) {
+        return min(chunkBytes, (endByte - offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+    }
+
+    ssize_t readChunk(char* buffer, const size_t offset, const size_t toRead) {
+        const auto start = chrono::steady_clock::now();
+        size_t done = 0;
+        while (done < toRead) {
+            const ssize_t got = pread(fd, buffer + done, toRead - done, offset + done);
+            if (got < 0 && direct && done == 0 && errno == EINVAL) {
+                // O_DIRECT accepted by open but not by the file system
+                close(fd);
+                fd = -1;
+                direct = false;
+                openFile();
+                continue;
+            }
+            if (got <= 0)
+                break;
+            done += got;
+        }
+        readSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        readBytes += done;
+        return done;
+    }
+};
+
+#endif //VALUESFILE_H